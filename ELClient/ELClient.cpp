@@ -15,6 +15,12 @@
 
 #define DEFAULT_SLIP_BUFFER_SIZE 128
 
+#if ELCLIENT_STATS
+#define STAT_ADD(field, n) (_stats.field += (n)) /**< Add to a counter of ELClientStats */
+#else
+#define STAT_ADD(field, n)
+#endif
+
 //===== Input
 
 /*! protoCompletedCb(void *res)
@@ -33,51 +39,39 @@
 ELClientPacket* ELClient::protoCompletedCb(void) {
   // the packet starts with a ELClientPacket
   ELClientPacket* packet = (ELClientPacket*)_proto.buf;
-  if (_debugEn) {
-    _debug->print("ELC: got ");
-    _debug->print(_proto.dataLen);
-    _debug->print(" @");
-    _debug->print((uint32_t)_proto.buf, 16);
-    _debug->print(": ");
-    _debug->print(packet->cmd, 16);
-    _debug->print(" ");
-    _debug->print(packet->value, 16);
-    _debug->print(" ");
-    _debug->print(packet->argc, 16);
-    for (uint16_t i=8; i<_proto.dataLen; i++) {
-      _debug->print(" ");
-      _debug->print(*(uint8_t*)(_proto.buf+i), 16);
-    }
-    _debug->println();
-  }
 
   // verify CRC
   uint16_t crc = crc16Data(_proto.buf, _proto.dataLen-2, 0);
   uint16_t resp_crc = *(uint16_t*)(_proto.buf+_proto.dataLen-2);
+  Trace(ELC_TRACE_RX, crc == resp_crc ? ELC_TRACE_CRC_OK : 0, packet->cmd, _proto.dataLen);
   if (crc != resp_crc) {
     DBG("ELC: Invalid CRC");
+    STAT_ADD(crcErrors, 1);
+    rxError();
     return NULL;
   }
+  STAT_ADD(framesIn, 1);
 
   // dispatch based on command
   if (packet->cmd == CMD_RESP_V) {
     // value response
-    if (_debugEn) {
-        _debug->print("RESP_V: ");
-        _debug->println(packet->value);
+    // answer to a sync probe
+    if (packet->value == ELC_HANDLE_WIFI && (_syncState == ELC_SYNC_WAIT || _syncProbes)) {
+      if (_syncProbes) _syncProbes--;
+      if (_syncState == ELC_SYNC_WAIT) syncDone();
+      return NULL;
     }
+    // hand it to a pending request or to the caller
+    if (pendingResolve(packet->value)) return NULL;
     return packet;
   } else if (packet->cmd == CMD_RESP_CB) {
-    FP<void, void*> *fp;
-    // callback reponse
-    if (_debugEn) {
-        _debug->print("RESP_CB: ");
-        _debug->print(packet->value);
-        _debug->print(" ");
-        _debug->println(packet->argc);
-    }
-    fp = (FP<void, void*>*)packet->value;
-    if (fp->attached()) {
+    // callback reponse, the value is a handle from Handle()
+    uint32_t index = packet->value - (ELC_HANDLE_BASE + 1);
+    FP<void, void*> *fp = index < ELCLIENT_MAX_CALLBACKS ? _callbacks[index] : NULL;
+    if (fp == NULL) {
+      DBG("ELC: unknown callback");
+      STAT_ADD(unhandled, 1);
+    } else if (fp->attached()) {
       ELClientResponse resp(packet);
       (*fp)(&resp);
     }
@@ -90,6 +84,7 @@ ELClientPacket* ELClient::protoCompletedCb(void) {
     }
     // command (NOT IMPLEMENTED)
     if (_debugEn) _debug->println("CMD??");
+    STAT_ADD(unhandled, 1);
     return NULL;
   }
 }
@@ -97,7 +92,10 @@ ELClientPacket* ELClient::protoCompletedCb(void) {
 /*! Process()
 @brief Handle serial input.
 @details Read all characters available on the serial input and process any messages that arrive,
-	but stop if a non-callback response comes in
+	but stop if a non-callback response comes in.
+	The input is read in blocks of up to ELCLIENT_RX_BLOCK_SIZE bytes, setting it to 0 selects
+	the original byte-at-a-time decoder. If a receive ring was set with SetReceiveRing() the
+	input is taken from the ring instead of the serial stream.
 @return <code>ELClientPacket</code>
 	Pointer to ELClientResponse structure with the received response
 @par Example
@@ -115,34 +113,445 @@ ELClientPacket* ELClient::protoCompletedCb(void) {
 @endcode
 */
 ELClientPacket *ELClient::Process() {
+  return Process(0, 0);
+}
+
+/*! Process(uint32_t maxMicros, uint16_t maxBytes)
+@brief Handle serial input within a time and byte budget
+@details Same as Process(), but returns once maxMicros have passed or maxBytes were taken from
+	the serial input, whichever comes first. The rest of the input stays in the serial buffer
+	(or in the receive block) for the next call. The time is checked between blocks of up to
+	ELCLIENT_RX_BLOCK_SIZE bytes, so a callback that runs long still overruns the budget.
+	The time spent in each call is recorded, see ProcessMicros() and ProcessMaxMicros().
+@param maxMicros
+	Time budget in microseconds, 0 for no limit
+@param maxBytes
+	Maximum number of received bytes to decode, 0 for no limit
+@return <code>ELClientPacket</code>
+	Pointer to ELClientResponse structure with the received response
+@par Example
+@code
+	void loop()
+	{
+		// spend at most 500us on esp-link per loop
+		esp.Process(500, 0);
+		controlStep();
+	}
+@endcode
+*/
+ELClientPacket *ELClient::Process(uint32_t maxMicros, uint16_t maxBytes) {
+  uint32_t start = micros();
+  ELClientPacket *packet = processInput(start, maxMicros, maxBytes);
+  runServices();
+  _procLast = micros() - start;
+  if (_procLast > _procMax) _procMax = _procLast;
+  return packet;
+}
+
+/*! processInput(uint32_t start, uint32_t maxMicros, uint16_t maxBytes)
+@brief Decode serial input for Process()
+@note Internal library function
+@param start
+	micros() when Process() was called
+@param maxMicros
+	Time budget in microseconds, 0 for no limit
+@param maxBytes
+	Maximum number of received bytes to decode, 0 for no limit
+@return <code>ELClientPacket</code>
+	Pointer to the completed non-callback packet or NULL
+*/
+ELClientPacket *ELClient::processInput(uint32_t start, uint32_t maxMicros, uint16_t maxBytes) {
+  if (_resyncDue) resync();
+  if (_pendingWait || _pendingLate) pendingExpire();
+  if (_syncState == ELC_SYNC_WAIT) syncTick();
+  uint16_t left = maxBytes;
+#if ELCLIENT_RX_BLOCK_SIZE > 0
+  for (;;) {
+    if (maxBytes && left == 0) return NULL;
+    if (maxMicros && micros() - start >= maxMicros) return NULL;
+    if (_rxPos == _rxEnd) {
+      if (_ring != NULL) {
+        // take what the RX interrupt queued up
+        _rxPos = 0;
+        _rxEnd = _ring->read(_rxBlock, ELCLIENT_RX_BLOCK_SIZE);
+        STAT_ADD(bytesIn, _rxEnd);
+      } else {
+        // pull everything that is available in one go
+        int avail = _serial->available();
+        if (avail <= 0) return NULL;
+        if (avail > ELCLIENT_RX_BLOCK_SIZE) avail = ELCLIENT_RX_BLOCK_SIZE;
+        _rxPos = 0;
+        _rxEnd = _serial->readBytes((char*)_rxBlock, avail);
+        STAT_ADD(bytesIn, _rxEnd);
+      }
+      if (_rxEnd == 0) return NULL;
+    }
+    uint8_t end = _rxEnd;
+    if (maxBytes && left < (uint16_t)(end - _rxPos)) end = _rxPos + left;
+    uint8_t pos = _rxPos;
+    ELClientPacket *packet = protoDecodeBlock(end);
+    left -= _rxPos - pos;
+    if (packet != NULL) return packet;
+  }
+#else
   int value;
-  while (_serial->available()) {
-    value = _serial->read();
+  for (;;) {
+    if (maxBytes) {
+      if (left == 0) return NULL;
+      left--;
+    }
+    if (_ring != NULL) {
+      uint8_t c;
+      if (_ring->read(&c, 1) == 0) return NULL;
+      value = c;
+    } else {
+      if (!_serial->available()) return NULL;
+      value = _serial->read();
+    }
+    STAT_ADD(bytesIn, 1);
     if (value == SLIP_ESC) {
       _proto.isEsc = 1;
     } else if (value == SLIP_END) {
-      ELClientPacket *packet = _proto.dataLen >= 8 ? protoCompletedCb() : 0;
-      _proto.dataLen = 0;
-      _proto.isEsc = 0;
+      ELClientPacket *packet = protoFrameEnd();
       if (packet != NULL) return packet;
+      if (maxMicros && micros() - start >= maxMicros) return NULL;
     } else {
       if (_proto.isEsc) {
         if (value == SLIP_ESC_END) value = SLIP_END;
         if (value == SLIP_ESC_ESC) value = SLIP_ESC;
         _proto.isEsc = 0;
       }
-      if (_proto.dataLen < _proto.bufSize) {
-        _proto.buf[_proto.dataLen++] = value;
-     }
+      uint8_t c = value;
+      protoAppend(&c, 1);
+    }
+  }
+#endif
+}
+
+#if ELCLIENT_RX_BLOCK_SIZE > 0
+/*! protoDecodeBlock(uint8_t end)
+@brief Decode the bytes in the receive block
+@details Runs of bytes without SLIP_END/SLIP_ESC are located with memchr and copied into the
+	protocol buffer in one go. Stops after a frame that produced a packet for the caller, the
+	remaining bytes stay in the block for the next call.
+@note
+	This function is usually not needed for applications. Process() calls it.
+@param end
+	Decode up to this position in the block, at most _rxEnd
+@return <code>ELClientPacket</code>
+	Pointer to the completed non-callback packet or NULL if the block was used up
+*/
+ELClientPacket *ELClient::protoDecodeBlock(uint8_t end) {
+  while (_rxPos < end) {
+    uint8_t *p = _rxBlock + _rxPos;
+    uint8_t c = *p;
+    if (_proto.isEsc && c != SLIP_END && c != SLIP_ESC) {
+      // the byte following SLIP_ESC
+      if (c == SLIP_ESC_END) c = SLIP_END;
+      if (c == SLIP_ESC_ESC) c = SLIP_ESC;
+      _proto.isEsc = 0;
+      protoAppend(&c, 1);
+      _rxPos++;
+      continue;
+    }
+
+    // copy the run up to the next SLIP_END or SLIP_ESC
+    uint8_t len = end - _rxPos;
+    uint8_t *special = (uint8_t*)memchr(p, SLIP_END, len);
+    if (special != NULL) len = special - p;
+    special = (uint8_t*)memchr(p, SLIP_ESC, len);
+    if (special != NULL) len = special - p;
+    if (len > 0) {
+      protoAppend(p, len);
+      _rxPos += len;
+      continue;
+    }
+
+    _rxPos++;
+    if (c == SLIP_ESC) {
+      _proto.isEsc = 1;
+    } else {
+      ELClientPacket *packet = protoFrameEnd();
+      if (packet != NULL) return packet;
     }
   }
   return NULL;
 }
+#endif
+
+/*! protoAppend(const uint8_t* data, uint16_t len)
+@brief Add decoded bytes to the frame being received
+@details Bytes that do not fit into the protocol buffer are dropped and the frame is marked as
+	overflowed. A valid frame that is too long says nothing about the link, so it does not count for
+	the reset detection.
+@note
+	This function is usually not needed for applications. Process() calls it.
+@param data
+	Pointer to the decoded bytes
+@param len
+	Number of decoded bytes
+*/
+void ELClient::protoAppend(const uint8_t* data, uint16_t len) {
+#if ELCLIENT_STREAM_SINKS > 0
+  if (_streamSink == NULL && _proto.dataLen < 8 && _proto.dataLen + len >= 8) {
+    // the header completes, it decides whether the frame is streamed
+    uint8_t n = 8 - _proto.dataLen;
+    if (n > _proto.bufSize - _proto.dataLen) n = 0; // buffer too small, overflow below
+    memcpy(_proto.buf + _proto.dataLen, data, n);
+    _proto.dataLen += n;
+    data += n;
+    len -= n;
+    if (n > 0) streamBegin();
+  }
+  if (_streamSink != NULL) {
+    streamAppend(data, len);
+    return;
+  }
+#endif
+  uint16_t room = _proto.bufSize - _proto.dataLen;
+  if (len > room) {
+    if (!_proto.overflow) {
+      _proto.overflow = 1;
+      Trace(ELC_TRACE_OVERFLOW, 0, 0, _proto.bufSize);
+      STAT_ADD(overflows, 1);
+    }
+    len = room;
+  }
+  memcpy(_proto.buf + _proto.dataLen, data, len);
+  _proto.dataLen += len;
+}
+
+/*! protoFrameEnd()
+@brief Handle a SLIP_END
+@details Process the frame received so far and reset the protocol state for the next one.
+	Frames that overflowed the buffer are dropped without checking the CRC.
+@note
+	This function is usually not needed for applications. Process() calls it.
+@return <code>ELClientPacket</code>
+	Pointer to the completed packet if it is a non-callback response, NULL otherwise
+*/
+ELClientPacket *ELClient::protoFrameEnd(void) {
+  ELClientPacket *packet = NULL;
+#if ELCLIENT_STREAM_SINKS > 0
+  if (_streamSink != NULL) streamEnd();
+  else
+#endif
+  if (_proto.overflow) ; // already counted
+  else if (_proto.dataLen >= 8) packet = protoCompletedCb();
+  else if (_proto.dataLen > 0) {
+    // runt, esp-link never sends these
+    Trace(ELC_TRACE_RUNT, 0, 0, _proto.dataLen);
+    STAT_ADD(runts, 1);
+    rxError();
+  }
+  _proto.dataLen = 0;
+  _proto.isEsc = 0;
+  _proto.overflow = 0;
+  return packet;
+}
+
+//===== Streaming receive
+
+#if ELCLIENT_STREAM_SINKS > 0
+/*! SetStreamSink(uint16_t cmd, uint32_t value, FP<void, void*> *sink)
+@brief Stream frames to a callback instead of receiving them into the receive buffer
+@details Frames whose header matches cmd and value are not collected in the receive buffer.
+	Their argument bytes are handed to the sink in chunks whenever the buffer fills up, so
+	frames of any size pass through a small buffer (at least 16 bytes). The CRC is computed
+	along the way and checked at the end of the frame, the sink is then called once more with
+	ELC_STREAM_END or ELC_STREAM_ERROR. Data received before an ELC_STREAM_ERROR must be dropped.
+	Streamed frames are not passed to callbacks or returned by Process().
+@param cmd
+	Command of the frames, e.g. CMD_RESP_CB for responses of a callback
+@param value
+	Value of the frames, e.g. the address of the callback, or 0 to stream all frames with cmd
+@param sink
+	Called with a pointer to an ELClientStreamChunk, NULL removes the sink of cmd and value
+@return <code>boolean</code>
+	False if the sink table (ELCLIENT_STREAM_SINKS entries) is full
+@par Example
+@code
+	// write the body of REST responses to an SD card instead of receiving them in restCallback,
+	// argument 0 is the HTTP status, argument 1 the body
+	FP<void, void*> bodySink;
+	void bodyChunk(void *c) {
+		ELClientStreamChunk *chunk = (ELClientStreamChunk *)c;
+		if (chunk->state == ELC_STREAM_DATA && chunk->arg == 1) file.write(chunk->data, chunk->len);
+		if (chunk->state == ELC_STREAM_END) file.close();
+	}
+	...
+	bodySink.attach(bodyChunk);
+	esp.SetStreamSink(CMD_RESP_CB, esp.Handle(&rest.restCb), &bodySink);
+@endcode
+*/
+boolean ELClient::SetStreamSink(uint16_t cmd, uint32_t value, FP<void, void*> *sink) {
+  ELClientStreamSink *slot = NULL;
+  for (uint8_t i=0; i<ELCLIENT_STREAM_SINKS; i++) {
+    ELClientStreamSink *s = &_streamSinks[i];
+    if (s->sink != NULL && s->cmd == cmd && s->value == value) {
+      if (_streamSink == s) {
+        // drop the rest of the frame being streamed
+        _streamSink = NULL;
+        _proto.overflow = 1;
+      }
+      s->sink = sink;
+      return true;
+    }
+    if (s->sink == NULL && slot == NULL) slot = s;
+  }
+  if (sink == NULL) return true;
+  if (slot == NULL) return false;
+  slot->cmd = cmd;
+  slot->value = value;
+  slot->sink = sink;
+  return true;
+}
+
+/*! streamBegin(void)
+@brief Check the header of the frame being received against the stream sinks
+@details Starts streaming if a sink matches, the header stays at the start of the buffer
+@note Internal library function
+*/
+void ELClient::streamBegin(void) {
+  ELClientPacket *packet = (ELClientPacket*)_proto.buf;
+  for (uint8_t i=0; i<ELCLIENT_STREAM_SINKS; i++) {
+    ELClientStreamSink *s = &_streamSinks[i];
+    if (s->sink != NULL && s->cmd == packet->cmd && (s->value == 0 || s->value == packet->value)) {
+      _streamSink = s;
+      _streamCrc = crc16Data(_proto.buf, 8, 0);
+      _streamLen = 0;
+      _streamArg = 0;
+      _streamArgLen = 0;
+      _streamPos = 0;
+      _streamHdr = 0;
+      _streamPad = 0;
+      return;
+    }
+  }
+}
+
+/*! streamAppend(const uint8_t* data, uint16_t len)
+@brief Add decoded bytes to the frame being streamed
+@details The bytes are collected after the header, a full buffer is handed to the sink except
+	for its last two bytes, which may be the CRC
+@note Internal library function
+@param data
+	Pointer to the decoded bytes
+@param len
+	Number of decoded bytes
+*/
+void ELClient::streamAppend(const uint8_t* data, uint16_t len) {
+  while (len > 0) {
+    uint16_t room = _proto.bufSize - _proto.dataLen;
+    if (room == 0) {
+      streamFlush(_proto.dataLen - 2);
+      room = _proto.bufSize - _proto.dataLen;
+    }
+    if (room > len) room = len;
+    memcpy(_proto.buf + _proto.dataLen, data, room);
+    _proto.dataLen += room;
+    data += room;
+    len -= room;
+  }
+}
+
+/*! streamFlush(uint16_t end)
+@brief Hand the buffered argument bytes up to end to the sink
+@details Splits the bytes into argument lengths, argument data and padding, only the data is
+	passed on. The bytes from end on are moved back behind the header.
+@note Internal library function
+@param end
+	Position in the buffer up to which bytes are delivered
+*/
+void ELClient::streamFlush(uint16_t end) {
+  ELClientPacket *packet = (ELClientPacket*)_proto.buf;
+  const uint8_t *p = _proto.buf + 8;
+  uint16_t n = end - 8;
+  _streamCrc = crc16Data(p, n, _streamCrc);
+  _streamLen += n;
+  while (n > 0 && _streamArg < packet->argc && _streamSink != NULL) {
+    if (_streamHdr < 2) {
+      // little endian length in front of each argument
+      _streamArgLen |= (uint16_t)*p++ << (8 * _streamHdr++);
+      n--;
+      _streamPos = 0;
+      _streamPad = (4 - ((_streamArgLen + 2) & 3)) & 3; // responses pad including the length
+    } else if (_streamPos < _streamArgLen) {
+      uint16_t m = _streamArgLen - _streamPos;
+      if (m > n) m = n;
+      streamChunk(ELC_STREAM_DATA, p, m);
+      _streamPos += m;
+      p += m;
+      n -= m;
+    } else if (_streamPad > 0) {
+      _streamPad--;
+      p++;
+      n--;
+    } else {
+      _streamArg++;
+      _streamArgLen = 0;
+      _streamHdr = 0;
+    }
+  }
+  uint16_t keep = _proto.dataLen - end;
+  memmove(_proto.buf + 8, _proto.buf + end, keep);
+  _proto.dataLen = 8 + keep;
+}
+
+/*! streamEnd(void)
+@brief Finish the frame being streamed at its SLIP_END
+@details Delivers the remaining argument bytes, checks the CRC and tells the sink the outcome
+@note Internal library function
+*/
+void ELClient::streamEnd(void) {
+  ELClientPacket *packet = (ELClientPacket*)_proto.buf;
+  boolean ok = false;
+  if (_proto.dataLen >= 10) {
+    streamFlush(_proto.dataLen - 2);
+    ok = _streamCrc == (uint16_t)(_proto.buf[8] | _proto.buf[9] << 8);
+  }
+  Trace(ELC_TRACE_RX, ok ? ELC_TRACE_CRC_OK : 0, packet->cmd, 8 + _streamLen + 2);
+  if (ok) {
+    STAT_ADD(framesIn, 1);
+  } else {
+    DBG("ELC: Invalid CRC");
+    STAT_ADD(crcErrors, 1);
+    rxError();
+  }
+  streamChunk(ok ? ELC_STREAM_END : ELC_STREAM_ERROR, NULL, 0);
+  _streamSink = NULL;
+}
+
+/*! streamChunk(uint8_t state, const uint8_t* data, uint16_t len)
+@brief Call the sink of the frame being streamed
+@note Internal library function
+@param state
+	ELClientStreamState of the chunk
+@param data
+	Argument bytes
+@param len
+	Number of argument bytes
+*/
+void ELClient::streamChunk(uint8_t state, const uint8_t* data, uint16_t len) {
+  ELClientStreamChunk chunk;
+  chunk.state = state;
+  chunk.packet = (ELClientPacket*)_proto.buf;
+  chunk.arg = _streamArg;
+  chunk.argLen = _streamArgLen;
+  chunk.offset = _streamPos;
+  chunk.data = data;
+  chunk.len = len;
+  if (_streamSink != NULL && _streamSink->sink->attached()) (*_streamSink->sink)(&chunk);
+}
+#endif
 
 /*! SetReceiveBufferSize(uint16_t size)
 @brief Reserve the memory for the receiving buffer
 @note
 	By default the max size of a datapacket is set to 128 bytes. If it is necessary to handle bigger data packets this function increases the available buffer size. 
+	All ELCLIENT_RX_SLOTS receive slots are resized, packets held with Acquire() are released and must not be used anymore.
+	Receive slots in caller storage (ELClientStatic) are not reallocated, the size is limited to
+	their size.
 @param size
 	Size of the buffer
 @par Example
@@ -154,17 +563,88 @@ ELClientPacket *ELClient::Process() {
 void ELClient::SetReceiveBufferSize(uint16_t size)
 {
   _proto.bufSize = size;
-  _proto.buf = realloc(_proto.buf, size);
-  
-  if( _proto.buf == 0 )
+  if (_rxStatic) {
+    if (size > _rxStatic) _proto.bufSize = _rxStatic;
+  } else {
+#ifndef ELCLIENT_NO_HEAP
+    for (uint8_t i=0; i<ELCLIENT_RX_SLOTS; i++) {
+      uint8_t *buf = (uint8_t*)realloc(_rxSlots[i], size);
+      if (buf == 0)
+        _proto.bufSize = 0;
+      else
+        _rxSlots[i] = buf;
+    }
+#else
     _proto.bufSize = 0;
+#endif
+  }
+  _rxHeld = 0;
+  _proto.buf = _rxSlots[0];
+  _proto.dataLen = 0;
+#if ELCLIENT_STREAM_SINKS > 0
+  _streamSink = NULL;
+#endif
+}
+
+/*! Acquire(ELClientPacket *packet)
+@brief Keep a received packet from being overwritten
+@details Marks the receive slot holding the packet as in use, further frames are received into
+	the other slots until Release() is called. This works for packets returned by Process() or
+	WaitReturn() and for the packet of an ELClientResponse inside a callback, as long as it is
+	called before the next call to Process().
+@note
+	Needs ELCLIENT_RX_SLOTS > 1, one slot always stays free for receiving.
+@param packet
+	Packet to hold
+@return <code>boolean</code>
+	True if the packet is held, false if there is no free slot left or the packet is not (or no longer) in a receive slot
+@par Example
+@code
+	ELClientPacket *pkt = esp.WaitReturn();
+	if (pkt && esp.Acquire(pkt)) {
+		// pkt stays valid while esp.Process() continues to receive
+		...
+		esp.Release(pkt);
+	}
+@endcode
+*/
+boolean ELClient::Acquire(ELClientPacket *packet)
+{
+  uint8_t slot = 0;
+  while (slot < ELCLIENT_RX_SLOTS && _rxSlots[slot] != (uint8_t*)packet) slot++;
+  if (slot == ELCLIENT_RX_SLOTS) return false;
+  if (_rxHeld & (1 << slot)) return true;
+  if (_proto.buf != (uint8_t*)packet) return false; // already overwritten
+
+  // continue receiving into a free slot
+  for (uint8_t i=0; i<ELCLIENT_RX_SLOTS; i++) {
+    if (i != slot && !(_rxHeld & (1 << i))) {
+      _proto.buf = _rxSlots[i];
+      _rxHeld |= 1 << slot;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*! Release(ELClientPacket *packet)
+@brief Give a packet held with Acquire() back to the receiver
+@param packet
+	Packet to release, NULL is ignored
+*/
+void ELClient::Release(ELClientPacket *packet)
+{
+  for (uint8_t i=0; i<ELCLIENT_RX_SLOTS; i++) {
+    if (_rxSlots[i] == (uint8_t*)packet) _rxHeld &= ~(1 << i);
+  }
 }
 
 //===== Output
 
 /*! write(uint8_t data)
 @brief Send a byte
-@details Write a byte to the output stream and perform SLIP escaping
+@details Append a byte to the output staging buffer and perform SLIP escaping. The buffer is
+	written to the output stream when it fills up and at the end of each request.
 @note
 	This function is usually not needed for applications. The communication to the ESP8266 is handled by the cmd, rest, mqtt, tcp and udp library parts.
 @param data
@@ -177,18 +657,35 @@ void ELClient::SetReceiveBufferSize(uint16_t size)
 void ELClient::write(uint8_t data) {
   switch (data) {
   case SLIP_END:
-    _serial->write(SLIP_ESC);
-    _serial->write(SLIP_ESC_END);
+    txPut(SLIP_ESC);
+    txPut(SLIP_ESC_END);
     break;
   case SLIP_ESC:
-    _serial->write(SLIP_ESC);
-    _serial->write(SLIP_ESC_ESC);
+    txPut(SLIP_ESC);
+    txPut(SLIP_ESC_ESC);
     break;
   default:
-    _serial->write(data);
+    txPut(data);
   }
 }
 
+/*! txFlush(void)
+@brief Write the output staging buffer to the serial stream
+@details All staged bytes are handed to the stream with a single Stream::write(buf, len) call,
+	which lets transports like the SC16IS750 bridge send them in one bus transaction.
+@note
+	This function is usually not needed for applications. Request(void) flushes the buffer at the end of each request.
+*/
+void ELClient::txFlush(void) {
+  if (_txLen == 0) return;
+#if ELCLIENT_TRACE_SIZE > 0
+  _txFrameLen += _txLen;
+#endif
+  STAT_ADD(bytesOut, _txLen);
+  _serial->write(_txBuf, _txLen);
+  _txLen = 0;
+}
+
 /*! write(void* data, uint16_t len)
 @brief Send several byte
 @details Write some bytes to the output stream, no SLIP escaping is performed
@@ -209,10 +706,114 @@ void ELClient::write(void* data, uint16_t len) {
     write(*d++);
 }
 
+/*! writeArg(const uint8_t* data, uint16_t len, uint8_t pad)
+@brief Send bytes with SLIP escaping and add them to the request CRC in one pass
+@details Each byte is checksummed and escaped into the staging buffer in the same loop, followed
+	by <code>pad</code> zero bytes. With the slice-by-4 CRC engine, runs of four bytes that need no
+	escaping are checksummed and copied with one step.
+@note
+	This function is usually not needed for applications. The communication to the ESP8266 is handled by the cmd, rest, mqtt, tcp and udp library parts.
+@param data
+	Pointer to data buffer to be sent
+@param len
+	Size of data buffer
+@param pad
+	Number of zero bytes to append
+*/
+void ELClient::writeArg(const uint8_t* data, uint16_t len, uint8_t pad) {
+  uint16_t acc = crc;
+  while (len > 0) {
+#if ELCLIENT_CRC_ENGINE == ELCLIENT_CRC_SLICE4
+    if (len >= 4 && _txLen <= ELCLIENT_TX_BUFFER_SIZE-4) {
+      uint32_t w;
+      memcpy(&w, data, 4);
+      uint32_t end = w ^ 0xC0C0C0C0UL, esc = w ^ 0xDBDBDBDBUL;
+      // a byte of end/esc is zero where data holds SLIP_END/SLIP_ESC
+      if (((((end - 0x01010101UL) & ~end) | ((esc - 0x01010101UL) & ~esc)) & 0x80808080UL) == 0) {
+        memcpy(_txBuf+_txLen, data, 4);
+        _txLen += 4;
+        acc = crc16DataSlice4(data, 4, acc);
+        data += 4;
+        len -= 4;
+        continue;
+      }
+    }
+#endif
+    uint8_t c = *data++;
+    len--;
+    acc = crc16Add(c, acc);
+    if (c == SLIP_END || c == SLIP_ESC) {
+      if (_txLen > ELCLIENT_TX_BUFFER_SIZE-2) txFlush();
+      _txBuf[_txLen++] = SLIP_ESC;
+      _txBuf[_txLen++] = c == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+    } else {
+      txPut(c);
+    }
+  }
+  while (pad--) {
+    acc = crc16Add(0, acc);
+    txPut(0);
+  }
+  crc = acc;
+}
+
+/*! writeFrame_P(const uint8_t* frame, uint16_t len)
+@brief Write a complete SLIP frame stored in flash
+@details The frame is copied into the output buffer in blocks with memcpy_P, no escaping or CRC
+	is done. Used by sendFrame() for requests encoded at compile time with ELClientFrame.
+@note
+	This function is usually not needed for applications. The communication to the ESP8266 is handled by the cmd, rest, mqtt, tcp and udp library parts.
+@param frame
+	Pointer to the encoded frame in flash, including both SLIP_END
+@param len
+	Length of the encoded frame
+*/
+void ELClient::writeFrame_P(const uint8_t* frame, uint16_t len) {
+  Trace(ELC_TRACE_TX, 0, pgm_read_byte(frame+1) | pgm_read_byte(frame+2) << 8, len);
+  STAT_ADD(framesOut, 1);
+  while (len > 0) {
+    if (_txLen == ELCLIENT_TX_BUFFER_SIZE) txFlush();
+    uint8_t n = ELCLIENT_TX_BUFFER_SIZE - _txLen;
+    if (n > len) n = len;
+    memcpy_P(_txBuf + _txLen, frame, n);
+    _txLen += n;
+    frame += n;
+    len -= n;
+  }
+  txFlush();
+}
+
+/*! writeEncoded(const uint8_t* data, uint16_t len, uint16_t acc)
+@brief Start a request with bytes that are already SLIP encoded
+@details The bytes are written to the serial stream in one go and the CRC continues from acc, so
+	arguments can be appended with Request() and the request finished with Request(void).
+	Used by ELClientFrameTemplate.
+@note
+	This function is usually not needed for applications. The communication to the ESP8266 is handled by the cmd, rest, mqtt, tcp and udp library parts.
+@param data
+	Pointer to the encoded bytes, starting with SLIP_END
+@param len
+	Number of encoded bytes
+@param acc
+	CRC of the unencoded bytes
+*/
+void ELClient::writeEncoded(const uint8_t* data, uint16_t len, uint16_t acc) {
+  txFlush();
+  _serial->write(data, len);
+  STAT_ADD(bytesOut, len);
+  crc = acc;
+#if ELCLIENT_TRACE_SIZE > 0
+  _txCmd = data[1] | data[2] << 8; // command values are never SLIP escaped
+  _txFrameLen = len;
+#endif
+}
+
 /*! Request(uint16_t cmd, uint32_t value, uint16_t argc)
 @brief Start a request
 @details Start preparing a request by sending the command, number of arguments
-	and the first argument (which can be a callback pointer)
+	and the first argument (which can be a callback pointer).
+	Requests with a known list of arguments are easier built with send(), which derives argc
+	from its arguments.
 @note
 	This function is usually not needed for applications. The communication to the ESP8266 is handled by the cmd, rest, mqtt, tcp and udp library parts.
 @param cmd
@@ -232,16 +833,18 @@ void ELClient::write(void* data, uint16_t len) {
 @endcode
 */
 void ELClient::Request(uint16_t cmd, uint32_t value, uint16_t argc) {
-  crc = 0;
-  _serial->write(SLIP_END);
-  write(&cmd, 2);
-  crc = crc16Data((unsigned const char*)&cmd, 2, crc);
-
-  write(&argc, 2);
-  crc = crc16Data((unsigned const char*)&argc, 2, crc);
+  ELClientPacket hdr;
+  hdr.cmd = cmd;
+  hdr.argc = argc;
+  hdr.value = value;
 
-  write(&value, 4);
-  crc = crc16Data((unsigned const char*)&value, 4, crc);
+#if ELCLIENT_TRACE_SIZE > 0
+  _txCmd = cmd;
+  _txFrameLen = 0;
+#endif
+  crc = 0;
+  txPut(SLIP_END);
+  writeArg((const uint8_t*)&hdr, 8, 0);
 }
 
 /*! Request(uint16_t cmd, uint32_t value, uint16_t argc)
@@ -264,26 +867,9 @@ void ELClient::Request(uint16_t cmd, uint32_t value, uint16_t argc) {
 @endcode
 */
 void ELClient::Request(const void* data, uint16_t len) {
-  uint8_t *d = (uint8_t*)data;
-
-  // write the length
-  write(&len, 2);
-  crc = crc16Data((unsigned const char*)&len, 2, crc);
-
-  // output the data
-  for (uint16_t l=len; l>0; l--) {
-    write(*d);
-    crc = crc16Add(*d, crc);
-    d++;
-  }
-
-  // output padding
-  uint16_t pad = (4-(len&3))&3;
-  uint8_t temp = 0;
-  while (pad--) {
-    write(temp);
-    crc = crc16Add(temp, crc);
-  }
+  // write the length, then the data followed by padding
+  writeArg((const uint8_t*)&len, 2, 0);
+  writeArg((const uint8_t*)data, len, (4-(len&3))&3);
 }
 
 /*! Request(const __FlashStringHelper* data, uint16_t len)
@@ -307,29 +893,24 @@ void ELClient::Request(const void* data, uint16_t len) {
 */
 void ELClient::Request(const __FlashStringHelper* data, uint16_t len) {
   // write the length
-  write(&len, 2);
-  crc = crc16Data((unsigned const char*)&len, 2, crc);
+  writeArg((const uint8_t*)&len, 2, 0);
 
-  // output the data
+  // output the data in chunks copied out of flash, the last chunk carries the padding
   PGM_P p = reinterpret_cast<PGM_P>(data);
-  for (uint16_t l=len; l>0; l--) {
-    uint8_t c = pgm_read_byte(p++);
-    write(c);
-    crc = crc16Add(c, crc);
-  }
-
-  // output padding
-  uint16_t pad = (4-(len&3))&3;
-  uint8_t temp = 0;
-  while (pad--) {
-    write(temp);
-    crc = crc16Add(temp, crc);
-  }
+  uint8_t chunk[16];
+  uint8_t pad = (4-(len&3))&3;
+  do {
+    uint8_t n = len > sizeof(chunk) ? sizeof(chunk) : len;
+    memcpy_P(chunk, p, n);
+    p += n;
+    len -= n;
+    writeArg(chunk, n, len == 0 ? pad : 0);
+  } while (len > 0);
 }
 
 /*! Request(void)
 @brief Finish the request
-@details Send final CRC and SLIP_END to the ESP to finish the request
+@details Send final CRC and SLIP_END to the ESP to finish the request and flush the output buffer
 @note
 	This function is usually not needed for applications. The communication to the ESP8266 is handled by the cmd, rest, mqtt, tcp and udp library parts.
 @par Example
@@ -344,26 +925,80 @@ void ELClient::Request(const __FlashStringHelper* data, uint16_t len) {
 */
 void ELClient::Request(void) {
   write((uint8_t*)&crc, 2);
-  _serial->write(SLIP_END);
+  txPut(SLIP_END);
+  txFlush();
+  STAT_ADD(framesOut, 1);
+#if ELCLIENT_TRACE_SIZE > 0
+  Trace(ELC_TRACE_TX, 0, _txCmd, _txFrameLen);
+#endif
 }
 
 //===== Initialization
 
-/*! init()
+/*! init(uint8_t* rxStorage, uint16_t rxSize)
 @brief Initialize ELClient protocol
-@details Prepare buffer for protocol
+@details Prepare the receive slots for the protocol, either in the caller storage or on the heap
 @note
 	This function is usually not needed for applications. The communication to the ESP8266 is handled by the cmd, rest, mqtt, tcp and udp library parts.
+@param rxStorage
+	ELCLIENT_RX_SLOTS buffers of rxSize bytes each, NULL to allocate DEFAULT_SLIP_BUFFER_SIZE bytes per slot
+@param rxSize
+	Size of each buffer in rxStorage
 @par Example
 @code
 	no example code yet
 @endcode
 */
-void ELClient::init() {
-  _proto.buf = malloc(DEFAULT_SLIP_BUFFER_SIZE);
-  _proto.bufSize = DEFAULT_SLIP_BUFFER_SIZE;
+void ELClient::init(uint8_t* rxStorage, uint16_t rxSize) {
+  if (rxStorage != NULL) {
+    _rxStatic = rxSize;
+    for (uint8_t i=0; i<ELCLIENT_RX_SLOTS; i++)
+      _rxSlots[i] = rxStorage + i * rxSize;
+  } else {
+    _rxStatic = 0;
+#ifndef ELCLIENT_NO_HEAP
+    rxSize = DEFAULT_SLIP_BUFFER_SIZE;
+    for (uint8_t i=0; i<ELCLIENT_RX_SLOTS; i++)
+      _rxSlots[i] = (uint8_t*)malloc(rxSize);
+#else
+    rxSize = 0; // nothing can be received
+    memset(_rxSlots, 0, sizeof(_rxSlots));
+#endif
+  }
+  _rxHeld = 0;
+  _proto.buf = _rxSlots[0];
+  _proto.bufSize = rxSize;
   _proto.dataLen = 0;
   _proto.isEsc = 0;
+  _proto.overflow = 0;
+#if ELCLIENT_STREAM_SINKS > 0
+  memset(_streamSinks, 0, sizeof(_streamSinks));
+  _streamSink = NULL;
+#endif
+  _txLen = 0;
+  _ring = NULL;
+  memset(_callbacks, 0, sizeof(_callbacks));
+  _callbacks[0] = &wifiCb; // ELC_HANDLE_WIFI
+  memset(_services, 0, sizeof(_services));
+  _serviceBusy = false;
+  memset(_pending, 0, sizeof(_pending));
+  _pendingToken = 0;
+  _pendingWait = 0;
+  _pendingLate = 0;
+  _syncState = ELC_SYNC_IDLE;
+  _syncEpoch = 0;
+  _syncProbes = 0;
+  _syncAuto = false;
+  _rxErrors = 0;
+  _resyncDue = false;
+  _procLast = 0;
+  _procMax = 0;
+  ResetStats();
+  ClearTrace();
+#if ELCLIENT_RX_BLOCK_SIZE > 0
+  _rxPos = 0;
+  _rxEnd = 0;
+#endif
 }
 
 /*! ELClient(Stream* serial)
@@ -391,10 +1026,11 @@ void ELClient::init() {
 	ELClient esp(&i2cuart);
 @endcode
 */
+#ifndef ELCLIENT_NO_HEAP
 ELClient::ELClient(Stream* serial) :
 _serial(serial), callbackPacketHandler(0) {
   _debugEn = false;
-  init();
+  init(NULL, 0);
 }
 
 /*! ELClient(Stream* serial, Stream* debug)
@@ -427,7 +1063,35 @@ _serial(serial), callbackPacketHandler(0) {
 ELClient::ELClient(Stream* serial, Stream* debug) :
 _debug(debug), _serial(serial), callbackPacketHandler(0) {
   _debugEn = true;
-  init();
+  init(NULL, 0);
+}
+#endif
+
+/*! ELClient(Stream* serial, Stream* debug, uint8_t* rxStorage, uint16_t rxSize)
+@brief Initialize ELClient with receive buffers in caller storage
+@details No heap is used for the receive slots. ELClientStatic provides the storage as part of
+	the object and is the usual way to use this constructor.
+@param serial
+	Serial stream for communication with ESP
+@param debug
+	Serial stream for debug output, NULL for none
+@param rxStorage
+	ELCLIENT_RX_SLOTS buffers of rxSize bytes each, one after the other
+@param rxSize
+	Size of each receive buffer, the largest frame that can be received
+@par Example
+@code
+	// with ELCLIENT_RX_SLOTS 1
+	static uint8_t rxBuf[96];
+	ELClient esp(&Serial, NULL, rxBuf, sizeof(rxBuf));
+	// or the same with the storage inside the object
+	ELClientStatic<96> esp(&Serial);
+@endcode
+*/
+ELClient::ELClient(Stream* serial, Stream* debug, uint8_t* rxStorage, uint16_t rxSize) :
+_debug(debug), _serial(serial), callbackPacketHandler(0) {
+  _debugEn = debug != NULL;
+  init(rxStorage, rxSize);
 }
 
 /*! ELClient::DBG(const char* info)
@@ -443,6 +1107,45 @@ void ELClient::DBG(const char* info) {
   if (_debugEn) _debug->println(info);
 }
 
+/*! DumpTrace(Stream* out)
+@brief Write the binary trace to a stream
+@details Writes the magic "ELTR", a version byte (1), the record size, the number of records and
+	a reserved byte, followed by the ELClientTraceRecord structures oldest first, little endian.
+	extras/eltrace.py turns a capture of this output into readable text. Nothing but the header
+	is written if ELCLIENT_TRACE_SIZE is 0.
+@param out
+	Stream to write the trace to, e.g. the debug serial port
+@par Example
+@code
+	// in a fault handler or on a button press
+	esp.DumpTrace(&Serial);
+@endcode
+*/
+void ELClient::DumpTrace(Stream* out) {
+  uint8_t hdr[8] = { 'E', 'L', 'T', 'R', 1, sizeof(ELClientTraceRecord), 0, 0 };
+#if ELCLIENT_TRACE_SIZE > 0
+  hdr[6] = _traceCount;
+  out->write(hdr, sizeof(hdr));
+  uint8_t i = _traceCount < ELCLIENT_TRACE_SIZE ? 0 : _traceHead;
+  for (uint8_t n = 0; n < _traceCount; n++) {
+    out->write((const uint8_t*)&_trace[i], sizeof(ELClientTraceRecord));
+    if (++i == ELCLIENT_TRACE_SIZE) i = 0;
+  }
+#else
+  out->write(hdr, sizeof(hdr));
+#endif
+}
+
+/*! ClearTrace(void)
+@brief Drop all records of the binary trace
+*/
+void ELClient::ClearTrace(void) {
+#if ELCLIENT_TRACE_SIZE > 0
+  _traceHead = 0;
+  _traceCount = 0;
+#endif
+}
+
 //===== Responses
 
 /*! WaitReturn(uint32_t timeout)
@@ -473,8 +1176,544 @@ ELClientPacket *ELClient::WaitReturn(uint32_t timeout) {
   return NULL;
 }
 
+//===== Pending requests
+
+/*! Expect(uint32_t timeout)
+@brief Register the request just sent as waiting for a CMD_RESP_V response
+@details esp-link handles requests one after the other, so its CMD_RESP_V responses come back in
+	the order the requests were sent. Process() routes each CMD_RESP_V to the oldest registered
+	request that is still waiting, instead of returning it. This allows several requests to be
+	outstanding at the same time while loop() keeps running.
+	A request that timed out keeps its place in that order for another timeout period, so that
+	its late response is dropped instead of being taken for the response of a request that was
+	already waiting with it. At most one response is dropped per timeout: a request registered
+	later ends this, as the response may have been lost and the next one is then its own, and a
+	request that waited while a late response was dropped does not drop another one when it
+	times out.
+@warning Do not mix Expect() with a raw WaitReturn(): while requests are registered, every
+	CMD_RESP_V is taken by the pending-request table, including the one WaitReturn() waits for.
+@param timeout
+	Time in milliseconds to wait for the response, defaults to ESP_TIMEOUT
+@param cb
+	(optional) Called from Process() with a pointer to the ELClientPending entry when the
+	request is done or timed out. The callback may change the entry's value before it is
+	handed to Poll() and ELClientFuture.
+@return <code>uint8_t</code>
+	Token to check the request with Poll(), 0 if the pending-request table is full
+@par Example
+@code
+	esp.Request(CMD_GET_TIME, 0, 0);
+	esp.Request();
+	uint8_t token = esp.Expect();
+	...
+	// in loop()
+	esp.Process();
+	uint32_t time;
+	if (esp.Poll(token, &time) == ELC_PENDING_DONE) {
+		Serial.println(time);
+	}
+@endcode
+*/
+uint8_t ELClient::Expect(uint32_t timeout, FP<void, void*> *cb) {
+  if (_pendingWait || _pendingLate) pendingExpire();
+  // requests that timed out before this one was sent are not waited for any more
+  if (_pendingLate) {
+    for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) _pending[i].late = false;
+    _pendingLate = 0;
+  }
+  ELClientPending *entry = NULL;
+  uint8_t oldest = 0;
+  for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+    ELClientPending *p = &_pending[i];
+    if (p->token == 0) {
+      entry = p;
+      break;
+    }
+    // reuse the oldest finished entry nobody has polled
+    uint8_t age = _pendingToken - p->token;
+    if (p->state != ELC_PENDING_WAIT && age >= oldest) {
+      entry = p;
+      oldest = age;
+    }
+  }
+  if (entry == NULL) return 0;
+
+  if (++_pendingToken == 0) _pendingToken = 1;
+  entry->token = _pendingToken;
+  entry->state = ELC_PENDING_WAIT;
+  entry->start = millis();
+  entry->timeout = timeout;
+  entry->late = false;
+  entry->shadowed = false;
+  entry->cb = cb;
+  entry->userCb = NULL;
+  _pendingWait++;
+  return entry->token;
+}
+
+/*! Poll(uint8_t token, uint32_t *value)
+@brief Check on a request registered with Expect()
+@details Does not block. Finished entries stay in the table, so a token can be polled again,
+	until Expect() needs their room for new requests.
+@param token
+	Token returned by Expect()
+@param value
+	Pointer to the variable that receives the response value once the request is done
+@return <code>uint8_t</code>
+	ELC_PENDING_WAIT, ELC_PENDING_DONE, ELC_PENDING_TIMEOUT or ELC_PENDING_UNKNOWN if the token
+	is not in the table (never issued or evicted)
+*/
+uint8_t ELClient::Poll(uint8_t token, uint32_t *value) {
+  if (token == 0) return ELC_PENDING_UNKNOWN;
+  for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+    ELClientPending *p = &_pending[i];
+    if (p->token != token) continue;
+    if (p->state == ELC_PENDING_DONE && value != NULL) *value = p->value;
+    return p->state;
+  }
+  return ELC_PENDING_UNKNOWN;
+}
+
+/*! Then(uint8_t token, FP<void, void*> *cb)
+@brief Attach a completion callback to a request registered with Expect()
+@param token
+	Token returned by Expect()
+@param cb
+	Called with a pointer to the ELClientPending entry when the request is done or timed out,
+	immediately if that already happened
+@return <code>boolean</code>
+	False if the token is not in the table
+*/
+boolean ELClient::Then(uint8_t token, FP<void, void*> *cb) {
+  if (token == 0) return false;
+  for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+    ELClientPending *p = &_pending[i];
+    if (p->token != token) continue;
+    if (p->state == ELC_PENDING_WAIT) {
+      p->userCb = cb;
+    } else if (cb != NULL && cb->attached()) {
+      (*cb)(p);
+    }
+    return true;
+  }
+  return false;
+}
+
+/*! WaitFor(uint8_t token, uint32_t *value)
+@brief Busy wait for a request registered with Expect()
+@details Keeps calling Process(), so callbacks and other pending requests are served meanwhile
+@param token
+	Token returned by Expect()
+@param value
+	Pointer to the variable that receives the response value
+@return <code>boolean</code>
+	True if the response arrived, false if the request timed out or the token is unknown
+*/
+boolean ELClient::WaitFor(uint8_t token, uint32_t *value) {
+  uint8_t state;
+  while ((state = Poll(token, value)) == ELC_PENDING_WAIT) {
+    Process();
+  }
+  return state == ELC_PENDING_DONE;
+}
+
+/*! Cancel(uint8_t token)
+@brief Remove a request registered with Expect() from the pending-request table
+@details Its CMD_RESP_V is returned by Process() again, e.g. to WaitReturn(). ELClientFuture
+	uses this for requests whose future is dropped without being looked at.
+@param token
+	Token returned by Expect()
+@return <code>boolean</code>
+	False if the token is not in the table or the request is not waiting any more
+*/
+boolean ELClient::Cancel(uint8_t token) {
+  if (token == 0) return false;
+  for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+    ELClientPending *p = &_pending[i];
+    if (p->token != token || p->state != ELC_PENDING_WAIT) continue;
+    p->token = 0;
+    p->state = ELC_PENDING_UNKNOWN;
+    _pendingWait--;
+    return true;
+  }
+  return false;
+}
+
+/*! pendingResolve(uint32_t value)
+@brief Complete the oldest waiting request with a CMD_RESP_V value
+@details If the oldest request timed out already, the value is its late response and is dropped
+@param value
+	Value of the response
+@return <code>boolean</code>
+	True if a waiting or timed out request took the value
+*/
+boolean ELClient::pendingResolve(uint32_t value) {
+  if (_pendingWait == 0 && _pendingLate == 0) return false;
+  ELClientPending *entry = NULL;
+  uint8_t oldest = 0;
+  for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+    ELClientPending *p = &_pending[i];
+    uint8_t age = _pendingToken - p->token;
+    if (p->token != 0 && (p->state == ELC_PENDING_WAIT || p->late) &&
+        (entry == NULL || age > oldest)) {
+      entry = p;
+      oldest = age;
+    }
+  }
+  if (entry == NULL) return false;
+  if (entry->late) {
+    entry->late = false;
+    _pendingLate--;
+    // if the late response was lost after all, this was the response of a waiting request,
+    // which must not drop the next one in turn when it times out
+    for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+      if (_pending[i].token != 0 && _pending[i].state == ELC_PENDING_WAIT) _pending[i].shadowed = true;
+    }
+    Trace(ELC_TRACE_TIMEOUT, ELC_TRACE_LATE, 0, entry->token);
+    return true;
+  }
+  entry->value = value;
+  entry->state = ELC_PENDING_DONE;
+  _pendingWait--;
+  statLatency(millis() - entry->start);
+  pendingDone(entry);
+  return true;
+}
+
+/*! pendingExpire(void)
+@brief Mark waiting requests whose timeout has passed as timed out
+@details A timed out request waits for its late response for another timeout period, or until
+	Expect() registers a new request, after that esp-link is assumed to have dropped the request.
+	A request that was shadowed by a dropped late response does not wait for its own.
+*/
+void ELClient::pendingExpire(void) {
+  uint32_t now = millis();
+  for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+    ELClientPending *p = &_pending[i];
+    if (p->late && now - p->start >= 2 * p->timeout) {
+      p->late = false;
+      _pendingLate--;
+    }
+    if (p->token != 0 && p->state == ELC_PENDING_WAIT && now - p->start >= p->timeout) {
+      p->state = ELC_PENDING_TIMEOUT;
+      _pendingWait--;
+      if (!p->shadowed) {
+        p->late = true;
+        _pendingLate++;
+      }
+      Trace(ELC_TRACE_TIMEOUT, 0, 0, p->token);
+      STAT_ADD(timeouts, 1);
+      pendingDone(p);
+    }
+  }
+}
+
+/*! pendingClear(void)
+@brief Drop all pending requests, used when esp-link is resynchronized and will not answer them
+*/
+void ELClient::pendingClear(void) {
+  _pendingWait = 0;
+  _pendingLate = 0;
+  for (uint8_t i=0; i<ELCLIENT_MAX_PENDING; i++) {
+    _pending[i].late = false;
+    if (_pending[i].token != 0 && _pending[i].state == ELC_PENDING_WAIT) {
+      _pending[i].state = ELC_PENDING_TIMEOUT;
+      pendingDone(&_pending[i]);
+    }
+  }
+}
+
+/*! pendingDone(ELClientPending *entry)
+@brief Call the completion callbacks of a request that is done or timed out
+@param entry
+	Finished entry of the pending-request table
+*/
+void ELClient::pendingDone(ELClientPending *entry) {
+  if (entry->cb != NULL && entry->cb->attached()) (*entry->cb)(entry);
+  if (entry->userCb != NULL && entry->userCb->attached()) (*entry->userCb)(entry);
+}
+
+//===== Callback handles
+
+/*! Handle(FP<void, void*> *cb)
+@brief Get the handle that identifies a callback to esp-link
+@details esp-link stores the value sent with a set-up request and returns it in every
+	CMD_RESP_CB for that set-up. Sending a handle instead of the address of the FP keeps the
+	value within 32 bits on any platform, and Process() only calls callbacks that are in the
+	table, so a corrupted frame cannot make it jump to an arbitrary address.
+	The wifiCb always has ELC_HANDLE_WIFI.
+@param cb
+	Callback to be called with an ELClientResponse pointer
+@return <code>uint32_t</code>
+	Handle to send as callback value, 0 if the table is full
+@par Example
+@code
+	// same as ELClientRest::begin
+	_elc->send(CMD_REST_SETUP, _elc->Handle(&restCb), host, port, sec);
+@endcode
+*/
+uint32_t ELClient::Handle(FP<void, void*> *cb) {
+  uint8_t slot = ELCLIENT_MAX_CALLBACKS;
+  for (uint8_t i=0; i<ELCLIENT_MAX_CALLBACKS; i++) {
+    if (_callbacks[i] == cb) return ELC_HANDLE_BASE + 1 + i;
+    if (_callbacks[i] == NULL && slot == ELCLIENT_MAX_CALLBACKS) slot = i;
+  }
+  if (slot == ELCLIENT_MAX_CALLBACKS) {
+    DBG("ELC: callback table full");
+    return 0;
+  }
+  _callbacks[slot] = cb;
+  return ELC_HANDLE_BASE + 1 + slot;
+}
+
+/*! ReleaseHandle(FP<void, void*> *cb)
+@brief Remove a callback from the handle table
+@details Needed only for callbacks that go away, e.g. an ELClientRest object on the stack.
+	The wifiCb cannot be released.
+@param cb
+	Callback registered with Handle()
+*/
+void ELClient::ReleaseHandle(FP<void, void*> *cb) {
+  for (uint8_t i=1; i<ELCLIENT_MAX_CALLBACKS; i++) {
+    if (_callbacks[i] == cb) _callbacks[i] = NULL;
+  }
+}
+
+//===== Services
+
+/*! AddService(FP<void, void*> *service)
+@brief Register a callback for Process() to call
+@details The service is called with a pointer to the ELClient at the end of every Process() call,
+	after the input was handled. Library classes use it to send queued requests at their own
+	pace, e.g. the ELClientMqtt publish queue. A service that calls Process() itself does not
+	get called again from within.
+@param service
+	Callback to call
+@return <code>boolean</code>
+	True if the service is registered, false if ELCLIENT_MAX_SERVICES are already registered
+@par Example
+@code
+	FP<void, void*> blinkService;
+	blinkService.attach(blinkStep);
+	esp.AddService(&blinkService);
+@endcode
+*/
+boolean ELClient::AddService(FP<void, void*> *service) {
+  uint8_t slot = ELCLIENT_MAX_SERVICES;
+  for (uint8_t i=0; i<ELCLIENT_MAX_SERVICES; i++) {
+    if (_services[i] == service) return true;
+    if (_services[i] == NULL && slot == ELCLIENT_MAX_SERVICES) slot = i;
+  }
+  if (slot == ELCLIENT_MAX_SERVICES) {
+    DBG("ELC: service table full");
+    return false;
+  }
+  _services[slot] = service;
+  return true;
+}
+
+/*! RemoveService(FP<void, void*> *service)
+@brief Stop calling a service registered with AddService
+@param service
+	Callback registered with AddService
+*/
+void ELClient::RemoveService(FP<void, void*> *service) {
+  for (uint8_t i=0; i<ELCLIENT_MAX_SERVICES; i++) {
+    if (_services[i] == service) _services[i] = NULL;
+  }
+}
+
+/*! runServices(void)
+@brief Call the registered services, called at the end of Process()
+@note Internal library function
+*/
+void ELClient::runServices(void) {
+  if (_serviceBusy) return;
+  _serviceBusy = true;
+  for (uint8_t i=0; i<ELCLIENT_MAX_SERVICES; i++) {
+    if (_services[i] != NULL && _services[i]->attached()) (*_services[i])(this);
+  }
+  _serviceBusy = false;
+}
+
+//===== Statistics
+
+/*! ResetStats(void)
+@brief Zero all counters returned by GetStats()
+@par Example
+@code
+	const ELClientStats& st = esp.GetStats();
+	Serial.print("CRC errors: ");
+	Serial.println(st.crcErrors);
+	esp.ResetStats();
+@endcode
+*/
+void ELClient::ResetStats(void) {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+/*! statLatency(uint32_t ms)
+@brief Count a round-trip time in the log2 histogram of ELClientStats
+@param ms
+	Time from Expect() to the response in milliseconds
+*/
+void ELClient::statLatency(uint32_t ms) {
+#if ELCLIENT_STATS
+  uint8_t b = 0;
+  while (ms != 0 && b < ELCLIENT_LATENCY_BUCKETS-1) {
+    ms >>= 1;
+    b++;
+  }
+  _stats.latency[b]++;
+#else
+  (void)ms;
+#endif
+}
+
 //===== CRC helper functions
 
+// The CRC is the 16-bit CCITT polynomial in its reflected form (0x8408) with a zero initial
+// value. crc16Table[i] is crc16Add(i, 0), crc16SliceN[i] is crc16Table[i] followed by N zero
+// bytes, which lets crc16DataSlice4 fold four bytes into the checksum with four lookups.
+static const uint16_t crc16Table[256] PROGMEM = {
+  0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
+  0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
+  0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
+  0x9cc9, 0x8d40, 0xbfdb, 0xae52, 0xdaed, 0xcb64, 0xf9ff, 0xe876,
+  0x2102, 0x308b, 0x0210, 0x1399, 0x6726, 0x76af, 0x4434, 0x55bd,
+  0xad4a, 0xbcc3, 0x8e58, 0x9fd1, 0xeb6e, 0xfae7, 0xc87c, 0xd9f5,
+  0x3183, 0x200a, 0x1291, 0x0318, 0x77a7, 0x662e, 0x54b5, 0x453c,
+  0xbdcb, 0xac42, 0x9ed9, 0x8f50, 0xfbef, 0xea66, 0xd8fd, 0xc974,
+  0x4204, 0x538d, 0x6116, 0x709f, 0x0420, 0x15a9, 0x2732, 0x36bb,
+  0xce4c, 0xdfc5, 0xed5e, 0xfcd7, 0x8868, 0x99e1, 0xab7a, 0xbaf3,
+  0x5285, 0x430c, 0x7197, 0x601e, 0x14a1, 0x0528, 0x37b3, 0x263a,
+  0xdecd, 0xcf44, 0xfddf, 0xec56, 0x98e9, 0x8960, 0xbbfb, 0xaa72,
+  0x6306, 0x728f, 0x4014, 0x519d, 0x2522, 0x34ab, 0x0630, 0x17b9,
+  0xef4e, 0xfec7, 0xcc5c, 0xddd5, 0xa96a, 0xb8e3, 0x8a78, 0x9bf1,
+  0x7387, 0x620e, 0x5095, 0x411c, 0x35a3, 0x242a, 0x16b1, 0x0738,
+  0xffcf, 0xee46, 0xdcdd, 0xcd54, 0xb9eb, 0xa862, 0x9af9, 0x8b70,
+  0x8408, 0x9581, 0xa71a, 0xb693, 0xc22c, 0xd3a5, 0xe13e, 0xf0b7,
+  0x0840, 0x19c9, 0x2b52, 0x3adb, 0x4e64, 0x5fed, 0x6d76, 0x7cff,
+  0x9489, 0x8500, 0xb79b, 0xa612, 0xd2ad, 0xc324, 0xf1bf, 0xe036,
+  0x18c1, 0x0948, 0x3bd3, 0x2a5a, 0x5ee5, 0x4f6c, 0x7df7, 0x6c7e,
+  0xa50a, 0xb483, 0x8618, 0x9791, 0xe32e, 0xf2a7, 0xc03c, 0xd1b5,
+  0x2942, 0x38cb, 0x0a50, 0x1bd9, 0x6f66, 0x7eef, 0x4c74, 0x5dfd,
+  0xb58b, 0xa402, 0x9699, 0x8710, 0xf3af, 0xe226, 0xd0bd, 0xc134,
+  0x39c3, 0x284a, 0x1ad1, 0x0b58, 0x7fe7, 0x6e6e, 0x5cf5, 0x4d7c,
+  0xc60c, 0xd785, 0xe51e, 0xf497, 0x8028, 0x91a1, 0xa33a, 0xb2b3,
+  0x4a44, 0x5bcd, 0x6956, 0x78df, 0x0c60, 0x1de9, 0x2f72, 0x3efb,
+  0xd68d, 0xc704, 0xf59f, 0xe416, 0x90a9, 0x8120, 0xb3bb, 0xa232,
+  0x5ac5, 0x4b4c, 0x79d7, 0x685e, 0x1ce1, 0x0d68, 0x3ff3, 0x2e7a,
+  0xe70e, 0xf687, 0xc41c, 0xd595, 0xa12a, 0xb0a3, 0x8238, 0x93b1,
+  0x6b46, 0x7acf, 0x4854, 0x59dd, 0x2d62, 0x3ceb, 0x0e70, 0x1ff9,
+  0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
+  0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
+};
+static const uint16_t crc16Slice1[256] PROGMEM = {
+  0x0000, 0x19d8, 0x33b0, 0x2a68, 0x6760, 0x7eb8, 0x54d0, 0x4d08,
+  0xcec0, 0xd718, 0xfd70, 0xe4a8, 0xa9a0, 0xb078, 0x9a10, 0x83c8,
+  0x9591, 0x8c49, 0xa621, 0xbff9, 0xf2f1, 0xeb29, 0xc141, 0xd899,
+  0x5b51, 0x4289, 0x68e1, 0x7139, 0x3c31, 0x25e9, 0x0f81, 0x1659,
+  0x2333, 0x3aeb, 0x1083, 0x095b, 0x4453, 0x5d8b, 0x77e3, 0x6e3b,
+  0xedf3, 0xf42b, 0xde43, 0xc79b, 0x8a93, 0x934b, 0xb923, 0xa0fb,
+  0xb6a2, 0xaf7a, 0x8512, 0x9cca, 0xd1c2, 0xc81a, 0xe272, 0xfbaa,
+  0x7862, 0x61ba, 0x4bd2, 0x520a, 0x1f02, 0x06da, 0x2cb2, 0x356a,
+  0x4666, 0x5fbe, 0x75d6, 0x6c0e, 0x2106, 0x38de, 0x12b6, 0x0b6e,
+  0x88a6, 0x917e, 0xbb16, 0xa2ce, 0xefc6, 0xf61e, 0xdc76, 0xc5ae,
+  0xd3f7, 0xca2f, 0xe047, 0xf99f, 0xb497, 0xad4f, 0x8727, 0x9eff,
+  0x1d37, 0x04ef, 0x2e87, 0x375f, 0x7a57, 0x638f, 0x49e7, 0x503f,
+  0x6555, 0x7c8d, 0x56e5, 0x4f3d, 0x0235, 0x1bed, 0x3185, 0x285d,
+  0xab95, 0xb24d, 0x9825, 0x81fd, 0xccf5, 0xd52d, 0xff45, 0xe69d,
+  0xf0c4, 0xe91c, 0xc374, 0xdaac, 0x97a4, 0x8e7c, 0xa414, 0xbdcc,
+  0x3e04, 0x27dc, 0x0db4, 0x146c, 0x5964, 0x40bc, 0x6ad4, 0x730c,
+  0x8ccc, 0x9514, 0xbf7c, 0xa6a4, 0xebac, 0xf274, 0xd81c, 0xc1c4,
+  0x420c, 0x5bd4, 0x71bc, 0x6864, 0x256c, 0x3cb4, 0x16dc, 0x0f04,
+  0x195d, 0x0085, 0x2aed, 0x3335, 0x7e3d, 0x67e5, 0x4d8d, 0x5455,
+  0xd79d, 0xce45, 0xe42d, 0xfdf5, 0xb0fd, 0xa925, 0x834d, 0x9a95,
+  0xafff, 0xb627, 0x9c4f, 0x8597, 0xc89f, 0xd147, 0xfb2f, 0xe2f7,
+  0x613f, 0x78e7, 0x528f, 0x4b57, 0x065f, 0x1f87, 0x35ef, 0x2c37,
+  0x3a6e, 0x23b6, 0x09de, 0x1006, 0x5d0e, 0x44d6, 0x6ebe, 0x7766,
+  0xf4ae, 0xed76, 0xc71e, 0xdec6, 0x93ce, 0x8a16, 0xa07e, 0xb9a6,
+  0xcaaa, 0xd372, 0xf91a, 0xe0c2, 0xadca, 0xb412, 0x9e7a, 0x87a2,
+  0x046a, 0x1db2, 0x37da, 0x2e02, 0x630a, 0x7ad2, 0x50ba, 0x4962,
+  0x5f3b, 0x46e3, 0x6c8b, 0x7553, 0x385b, 0x2183, 0x0beb, 0x1233,
+  0x91fb, 0x8823, 0xa24b, 0xbb93, 0xf69b, 0xef43, 0xc52b, 0xdcf3,
+  0xe999, 0xf041, 0xda29, 0xc3f1, 0x8ef9, 0x9721, 0xbd49, 0xa491,
+  0x2759, 0x3e81, 0x14e9, 0x0d31, 0x4039, 0x59e1, 0x7389, 0x6a51,
+  0x7c08, 0x65d0, 0x4fb8, 0x5660, 0x1b68, 0x02b0, 0x28d8, 0x3100,
+  0xb2c8, 0xab10, 0x8178, 0x98a0, 0xd5a8, 0xcc70, 0xe618, 0xffc0
+};
+
+static const uint16_t crc16Slice2[256] PROGMEM = {
+  0x0000, 0x5adc, 0xb5b8, 0xef64, 0x6361, 0x39bd, 0xd6d9, 0x8c05,
+  0xc6c2, 0x9c1e, 0x737a, 0x29a6, 0xa5a3, 0xff7f, 0x101b, 0x4ac7,
+  0x8595, 0xdf49, 0x302d, 0x6af1, 0xe6f4, 0xbc28, 0x534c, 0x0990,
+  0x4357, 0x198b, 0xf6ef, 0xac33, 0x2036, 0x7aea, 0x958e, 0xcf52,
+  0x033b, 0x59e7, 0xb683, 0xec5f, 0x605a, 0x3a86, 0xd5e2, 0x8f3e,
+  0xc5f9, 0x9f25, 0x7041, 0x2a9d, 0xa698, 0xfc44, 0x1320, 0x49fc,
+  0x86ae, 0xdc72, 0x3316, 0x69ca, 0xe5cf, 0xbf13, 0x5077, 0x0aab,
+  0x406c, 0x1ab0, 0xf5d4, 0xaf08, 0x230d, 0x79d1, 0x96b5, 0xcc69,
+  0x0676, 0x5caa, 0xb3ce, 0xe912, 0x6517, 0x3fcb, 0xd0af, 0x8a73,
+  0xc0b4, 0x9a68, 0x750c, 0x2fd0, 0xa3d5, 0xf909, 0x166d, 0x4cb1,
+  0x83e3, 0xd93f, 0x365b, 0x6c87, 0xe082, 0xba5e, 0x553a, 0x0fe6,
+  0x4521, 0x1ffd, 0xf099, 0xaa45, 0x2640, 0x7c9c, 0x93f8, 0xc924,
+  0x054d, 0x5f91, 0xb0f5, 0xea29, 0x662c, 0x3cf0, 0xd394, 0x8948,
+  0xc38f, 0x9953, 0x7637, 0x2ceb, 0xa0ee, 0xfa32, 0x1556, 0x4f8a,
+  0x80d8, 0xda04, 0x3560, 0x6fbc, 0xe3b9, 0xb965, 0x5601, 0x0cdd,
+  0x461a, 0x1cc6, 0xf3a2, 0xa97e, 0x257b, 0x7fa7, 0x90c3, 0xca1f,
+  0x0cec, 0x5630, 0xb954, 0xe388, 0x6f8d, 0x3551, 0xda35, 0x80e9,
+  0xca2e, 0x90f2, 0x7f96, 0x254a, 0xa94f, 0xf393, 0x1cf7, 0x462b,
+  0x8979, 0xd3a5, 0x3cc1, 0x661d, 0xea18, 0xb0c4, 0x5fa0, 0x057c,
+  0x4fbb, 0x1567, 0xfa03, 0xa0df, 0x2cda, 0x7606, 0x9962, 0xc3be,
+  0x0fd7, 0x550b, 0xba6f, 0xe0b3, 0x6cb6, 0x366a, 0xd90e, 0x83d2,
+  0xc915, 0x93c9, 0x7cad, 0x2671, 0xaa74, 0xf0a8, 0x1fcc, 0x4510,
+  0x8a42, 0xd09e, 0x3ffa, 0x6526, 0xe923, 0xb3ff, 0x5c9b, 0x0647,
+  0x4c80, 0x165c, 0xf938, 0xa3e4, 0x2fe1, 0x753d, 0x9a59, 0xc085,
+  0x0a9a, 0x5046, 0xbf22, 0xe5fe, 0x69fb, 0x3327, 0xdc43, 0x869f,
+  0xcc58, 0x9684, 0x79e0, 0x233c, 0xaf39, 0xf5e5, 0x1a81, 0x405d,
+  0x8f0f, 0xd5d3, 0x3ab7, 0x606b, 0xec6e, 0xb6b2, 0x59d6, 0x030a,
+  0x49cd, 0x1311, 0xfc75, 0xa6a9, 0x2aac, 0x7070, 0x9f14, 0xc5c8,
+  0x09a1, 0x537d, 0xbc19, 0xe6c5, 0x6ac0, 0x301c, 0xdf78, 0x85a4,
+  0xcf63, 0x95bf, 0x7adb, 0x2007, 0xac02, 0xf6de, 0x19ba, 0x4366,
+  0x8c34, 0xd6e8, 0x398c, 0x6350, 0xef55, 0xb589, 0x5aed, 0x0031,
+  0x4af6, 0x102a, 0xff4e, 0xa592, 0x2997, 0x734b, 0x9c2f, 0xc6f3
+};
+
+static const uint16_t crc16Slice3[256] PROGMEM = {
+  0x0000, 0x1cbb, 0x3976, 0x25cd, 0x72ec, 0x6e57, 0x4b9a, 0x5721,
+  0xe5d8, 0xf963, 0xdcae, 0xc015, 0x9734, 0x8b8f, 0xae42, 0xb2f9,
+  0xc3a1, 0xdf1a, 0xfad7, 0xe66c, 0xb14d, 0xadf6, 0x883b, 0x9480,
+  0x2679, 0x3ac2, 0x1f0f, 0x03b4, 0x5495, 0x482e, 0x6de3, 0x7158,
+  0x8f53, 0x93e8, 0xb625, 0xaa9e, 0xfdbf, 0xe104, 0xc4c9, 0xd872,
+  0x6a8b, 0x7630, 0x53fd, 0x4f46, 0x1867, 0x04dc, 0x2111, 0x3daa,
+  0x4cf2, 0x5049, 0x7584, 0x693f, 0x3e1e, 0x22a5, 0x0768, 0x1bd3,
+  0xa92a, 0xb591, 0x905c, 0x8ce7, 0xdbc6, 0xc77d, 0xe2b0, 0xfe0b,
+  0x16b7, 0x0a0c, 0x2fc1, 0x337a, 0x645b, 0x78e0, 0x5d2d, 0x4196,
+  0xf36f, 0xefd4, 0xca19, 0xd6a2, 0x8183, 0x9d38, 0xb8f5, 0xa44e,
+  0xd516, 0xc9ad, 0xec60, 0xf0db, 0xa7fa, 0xbb41, 0x9e8c, 0x8237,
+  0x30ce, 0x2c75, 0x09b8, 0x1503, 0x4222, 0x5e99, 0x7b54, 0x67ef,
+  0x99e4, 0x855f, 0xa092, 0xbc29, 0xeb08, 0xf7b3, 0xd27e, 0xcec5,
+  0x7c3c, 0x6087, 0x454a, 0x59f1, 0x0ed0, 0x126b, 0x37a6, 0x2b1d,
+  0x5a45, 0x46fe, 0x6333, 0x7f88, 0x28a9, 0x3412, 0x11df, 0x0d64,
+  0xbf9d, 0xa326, 0x86eb, 0x9a50, 0xcd71, 0xd1ca, 0xf407, 0xe8bc,
+  0x2d6e, 0x31d5, 0x1418, 0x08a3, 0x5f82, 0x4339, 0x66f4, 0x7a4f,
+  0xc8b6, 0xd40d, 0xf1c0, 0xed7b, 0xba5a, 0xa6e1, 0x832c, 0x9f97,
+  0xeecf, 0xf274, 0xd7b9, 0xcb02, 0x9c23, 0x8098, 0xa555, 0xb9ee,
+  0x0b17, 0x17ac, 0x3261, 0x2eda, 0x79fb, 0x6540, 0x408d, 0x5c36,
+  0xa23d, 0xbe86, 0x9b4b, 0x87f0, 0xd0d1, 0xcc6a, 0xe9a7, 0xf51c,
+  0x47e5, 0x5b5e, 0x7e93, 0x6228, 0x3509, 0x29b2, 0x0c7f, 0x10c4,
+  0x619c, 0x7d27, 0x58ea, 0x4451, 0x1370, 0x0fcb, 0x2a06, 0x36bd,
+  0x8444, 0x98ff, 0xbd32, 0xa189, 0xf6a8, 0xea13, 0xcfde, 0xd365,
+  0x3bd9, 0x2762, 0x02af, 0x1e14, 0x4935, 0x558e, 0x7043, 0x6cf8,
+  0xde01, 0xc2ba, 0xe777, 0xfbcc, 0xaced, 0xb056, 0x959b, 0x8920,
+  0xf878, 0xe4c3, 0xc10e, 0xddb5, 0x8a94, 0x962f, 0xb3e2, 0xaf59,
+  0x1da0, 0x011b, 0x24d6, 0x386d, 0x6f4c, 0x73f7, 0x563a, 0x4a81,
+  0xb48a, 0xa831, 0x8dfc, 0x9147, 0xc666, 0xdadd, 0xff10, 0xe3ab,
+  0x5152, 0x4de9, 0x6824, 0x749f, 0x23be, 0x3f05, 0x1ac8, 0x0673,
+  0x772b, 0x6b90, 0x4e5d, 0x52e6, 0x05c7, 0x197c, 0x3cb1, 0x200a,
+  0x92f3, 0x8e48, 0xab85, 0xb73e, 0xe01f, 0xfca4, 0xd969, 0xc5d2
+};
+
 /*! crc16Add(unsigned char b, uint16_t acc)
 @brief Create CRC for a byte add it to an existing CRC checksum and return the result
 @param b
@@ -490,16 +1729,21 @@ ELClientPacket *ELClient::WaitReturn(uint32_t timeout) {
 */
 uint16_t ELClient::crc16Add(unsigned char b, uint16_t acc)
 {
+#if ELCLIENT_CRC_ENGINE == ELCLIENT_CRC_BITWISE
   acc ^= b;
   acc = (acc >> 8) | (acc << 8);
   acc ^= (acc & 0xff00) << 4;
   acc ^= (acc >> 8) >> 4;
   acc ^= (acc & 0xff00) >> 5;
   return acc;
+#else
+  return (acc >> 8) ^ pgm_read_word(&crc16Table[(uint8_t)(acc ^ b)]);
+#endif
 }
 
 /*! crc16Data(const unsigned char *data, uint16_t len, uint16_t acc)
 @brief Create/add CRC for a data buffer 
+@details Uses the CRC engine selected at build time with ELCLIENT_CRC_ENGINE
 @param data
 	The data buffer which will be CRCed
 @param len
@@ -515,15 +1759,88 @@ uint16_t ELClient::crc16Add(unsigned char b, uint16_t acc)
 */
 uint16_t ELClient::crc16Data(const unsigned char *data, uint16_t len, uint16_t acc)
 {
-  for (uint16_t i=0; i<len; i++)
-    acc = crc16Add(*data++, acc);
+#if ELCLIENT_CRC_ENGINE == ELCLIENT_CRC_SLICE4
+  return crc16DataSlice4(data, len, acc);
+#elif ELCLIENT_CRC_ENGINE == ELCLIENT_CRC_TABLE
+  return crc16DataTable(data, len, acc);
+#else
+  return crc16DataBitwise(data, len, acc);
+#endif
+}
+
+/*! crc16DataBitwise(const unsigned char *data, uint16_t len, uint16_t acc)
+@brief Create/add CRC for a data buffer with shifts and xors only
+@details Needs no tables, this is the engine used on AVRs by default
+@param data
+	The data buffer which will be CRCed
+@param len
+	Size of the data buffer
+@param acc
+	Existing CRC checksum
+@return <code>uint16_t</code>
+	New CRC checksum
+*/
+uint16_t ELClient::crc16DataBitwise(const unsigned char *data, uint16_t len, uint16_t acc)
+{
+  while (len--) {
+    acc ^= *data++;
+    acc = (acc >> 8) | (acc << 8);
+    acc ^= (acc & 0xff00) << 4;
+    acc ^= (acc >> 8) >> 4;
+    acc ^= (acc & 0xff00) >> 5;
+  }
+  return acc;
+}
+
+/*! crc16DataTable(const unsigned char *data, uint16_t len, uint16_t acc)
+@brief Create/add CRC for a data buffer with one table lookup per byte
+@param data
+	The data buffer which will be CRCed
+@param len
+	Size of the data buffer
+@param acc
+	Existing CRC checksum
+@return <code>uint16_t</code>
+	New CRC checksum
+*/
+uint16_t ELClient::crc16DataTable(const unsigned char *data, uint16_t len, uint16_t acc)
+{
+  while (len--)
+    acc = (acc >> 8) ^ pgm_read_word(&crc16Table[(uint8_t)(acc ^ *data++)]);
   return acc;
 }
 
+/*! crc16DataSlice4(const unsigned char *data, uint16_t len, uint16_t acc)
+@brief Create/add CRC for a data buffer four bytes at a time
+@details Meant for 32-bit MCUs and hosts, on AVRs the 2KB of tables are only linked in if this
+	function is actually referenced
+@param data
+	The data buffer which will be CRCed
+@param len
+	Size of the data buffer
+@param acc
+	Existing CRC checksum
+@return <code>uint16_t</code>
+	New CRC checksum
+*/
+uint16_t ELClient::crc16DataSlice4(const unsigned char *data, uint16_t len, uint16_t acc)
+{
+  while (len >= 4) {
+    acc ^= data[0] | (data[1] << 8);
+    acc = pgm_read_word(&crc16Slice3[acc & 0xff]) ^ pgm_read_word(&crc16Slice2[acc >> 8]) ^
+          pgm_read_word(&crc16Slice1[data[2]]) ^ pgm_read_word(&crc16Table[data[3]]);
+    data += 4;
+    len -= 4;
+  }
+  return crc16DataTable(data, len, acc);
+}
+
 //===== Basic requests built into ElClient
 
 /*! Sync(uint32_t timeout)
 @brief Synchronize the communication between the MCU and the ESP
+@details Blocking wrapper around SyncStart() and SyncPoll(). Responses that arrive meanwhile and
+	are not for a pending request are dropped.
 @param timeout
 	Timeout for synchronization request
 @return <code>boolean</code>
@@ -542,41 +1859,152 @@ uint16_t ELClient::crc16Data(const unsigned char *data, uint16_t len, uint16_t a
 @endcode
 */
 boolean ELClient::Sync(uint32_t timeout) {
-  // send sync request
-  Request(CMD_SYNC, (uint32_t)&wifiCb, 0);
-  Request();
-  // empty the response queue hoping to find the wifiCb address
-  ELClientPacket *packet;
-  while ((packet = WaitReturn(timeout)) != NULL) {
-    if (packet->value == (uint32_t)&wifiCb) { 
-        if (_debugEn) _debug->println("SYNC!");
-        return true;
-    }
-    if (_debugEn) {
-        _debug->print("BAD: ");
-        _debug->println(packet->value);
-    }
+  SyncStart(timeout);
+  uint8_t state;
+  while ((state = SyncPoll()) == ELC_SYNC_WAIT) ;
+  return state == ELC_SYNC_DONE;
+}
+
+/*! SyncStart(uint32_t timeout)
+@brief Start synchronizing with esp-link without blocking
+@details Sends a sync probe right away and another one every ELCLIENT_SYNC_PROBE_MS from
+	Process() until esp-link echoes the wifiCb handle, so a freshly booted esp-link is picked
+	up within one probe interval. All pending requests are dropped because esp-link forgets
+	them when it syncs.
+@param timeout
+	Time in milliseconds after which the sync fails
+@par Example
+@code
+	esp.wifiCb.attach(wifiCb);
+	esp.SyncStart();
+	// ... in loop()
+	esp.Process();
+	if (esp.SyncState() == ELC_SYNC_FAILED) esp.SyncStart();
+@endcode
+*/
+void ELClient::SyncStart(uint32_t timeout) {
+  // esp-link forgets about all requests in progress
+  pendingClear();
+  _syncState = ELC_SYNC_WAIT;
+  _syncAuto = false;
+  _syncProbes = 0;
+  _syncStart = millis();
+  _syncTimeout = timeout;
+  _rxErrors = 0;
+  _resyncDue = false;
+  syncProbe();
+}
+
+/*! SyncPoll(void)
+@brief Continue a sync started with SyncStart()
+@details Calls Process() once, so it does not block
+@return <code>uint8_t</code>
+	ELClientSyncState, ELC_SYNC_WAIT while the sync is still in progress
+*/
+uint8_t ELClient::SyncPoll(void) {
+  ELClientPacket *packet = Process();
+  if (packet != NULL && _debugEn) {
+    _debug->print("BAD: ");
+    _debug->println(packet->value);
   }
-  // doesn't look like we got a real response
-  return false;
+  return _syncState;
+}
+
+/*! syncProbe(void)
+@brief Send a CMD_SYNC carrying the wifiCb handle
+@note Internal library function
+*/
+void ELClient::syncProbe(void) {
+  send(CMD_SYNC, (uint32_t)ELC_HANDLE_WIFI);
+  _syncSent = millis();
+  if (_syncProbes < 255) _syncProbes++;
+}
+
+/*! syncTick(void)
+@brief Send the next sync probe or give up, called by Process() while ELC_SYNC_WAIT
+@details A sync started by the reset detection does not time out, it keeps probing until
+	esp-link is back.
+@note Internal library function
+*/
+void ELClient::syncTick(void) {
+  uint32_t now = millis();
+  if (!_syncAuto && now - _syncStart >= _syncTimeout) {
+    _syncState = ELC_SYNC_FAILED;
+    DBG("ELC: sync failed");
+    return;
+  }
+  if (now - _syncSent >= ELCLIENT_SYNC_PROBE_MS) syncProbe();
+}
+
+/*! syncDone(void)
+@brief esp-link echoed a sync probe
+@note Internal library function
+*/
+void ELClient::syncDone(void) {
+  _syncState = ELC_SYNC_DONE;
+  _syncAuto = false;
+  if (++_syncEpoch == 0) _syncEpoch = 1;
+  Trace(ELC_TRACE_SYNC, 0, CMD_SYNC, _syncEpoch);
+  DBG("SYNC!");
+  if (syncCb.attached()) syncCb(this);
+}
+
+/*! rxError(void)
+@brief Count a bad frame for the reset detection
+@details esp-link prints its boot messages at a different baud rate, which shows up as a burst
+	of CRC errors and runts. ELCLIENT_RESET_ERRORS of them within ELCLIENT_RESET_WINDOW_MS
+	schedule an automatic resync if ELCLIENT_AUTO_RESYNC is set. The resync is started by the
+	next Process() call, not from within the receive path.
+@note Internal library function
+*/
+void ELClient::rxError(void) {
+  uint32_t now = millis();
+  if (_rxErrors == 0 || now - _rxErrorAt > ELCLIENT_RESET_WINDOW_MS) {
+    _rxErrors = 0;
+    _rxErrorAt = now;
+  }
+  if (++_rxErrors < ELCLIENT_RESET_ERRORS) return;
+  _rxErrors = 0;
+#if ELCLIENT_AUTO_RESYNC
+  if (_syncState == ELC_SYNC_DONE) _resyncDue = true;
+#endif
+}
+
+/*! resync(void)
+@brief Start the resync scheduled by the reset detection, called at the start of Process()
+@details esp-link forgets all callbacks when it resets, so the sketch has to register them again
+	(e.g. call mqtt.setup() again) from syncCb once the resync completes.
+@note Internal library function
+*/
+void ELClient::resync(void) {
+  _resyncDue = false;
+  if (_syncState != ELC_SYNC_DONE) return;
+  DBG("ELC: esp-link reset, resyncing");
+  Trace(ELC_TRACE_RESET, 0, 0, 0);
+  SyncStart(ESP_TIMEOUT);
+  _syncAuto = true;
 }
 
 /*! GetWifiStatus(void)
 @brief Request WiFi status from the ESP
+@return <code>ELClientFuture<uint8_t></code>
+	Completes with the WIFI_STATUS value from Process(), converting it to uint8_t waits for it.
+	If the future is dropped unused, the response is returned by Process() (e.g. to WaitReturn())
+	as it was before GetWifiStatus() returned a future.
 @par Example
 @code
 	// Wait for WiFi to be connected. 
-	esp.GetWifiStatus();
-	ELClientPacket *packet;
+	ELClientFuture<uint8_t> status = esp.GetWifiStatus();
 	Serial.print("Waiting for WiFi ");
-	if ((packet=esp.WaitReturn()) != NULL) {
+	status.wait();
+	if (status.ok()) {
 		Serial.print(".");
-		Serial.println(packet->value);
+		Serial.println(status.value());
 	}
 	Serial.println("");
 @endcode
 */
-void ELClient::GetWifiStatus(void) {
-  Request(CMD_WIFI_STATUS, 0, 0);
-  Request();
+ELClientFuture<uint8_t> ELClient::GetWifiStatus(void) {
+  sendFrame<ELClientFrame<CMD_WIFI_STATUS, 0> >();
+  return ELClientFuture<uint8_t>(this, Expect(), 0, false);
 }
@@ -9,10 +9,92 @@
 #include <HardwareSerial.h>
 #include <Arduino.h>
 #include "ELClientResponse.h"
+#include "ELClientRing.h"
+#include "ELClientFrame.h"
 #include "FP.h"
 
 #define ESP_TIMEOUT 2000 /**< Default timeout for TCP requests when waiting for a response */
 
+// CRC engines that can be selected at build time with ELCLIENT_CRC_ENGINE, all of them produce
+// the same checksum
+#define ELCLIENT_CRC_BITWISE 0 /**< Shift/xor per byte, no tables, smallest code */
+#define ELCLIENT_CRC_TABLE   1 /**< One 256 entry table in flash (512 bytes) */
+#define ELCLIENT_CRC_SLICE4  2 /**< Four 256 entry tables in flash (2KB), processes 4 bytes per step */
+
+#ifndef ELCLIENT_CRC_ENGINE
+#ifdef __AVR__
+#define ELCLIENT_CRC_ENGINE ELCLIENT_CRC_BITWISE /**< Default CRC engine for small AVRs */
+#else
+#define ELCLIENT_CRC_ENGINE ELCLIENT_CRC_SLICE4  /**< Default CRC engine for 32-bit MCUs and hosts */
+#endif
+#endif
+
+#ifndef ELCLIENT_TX_BUFFER_SIZE
+#define ELCLIENT_TX_BUFFER_SIZE 32 /**< Size of the SLIP encoder staging buffer (max 255), it is flushed to the serial stream in one write when full and at the end of every request */
+#endif
+
+#ifndef ELCLIENT_RX_BLOCK_SIZE
+#define ELCLIENT_RX_BLOCK_SIZE 32 /**< Number of bytes Process() reads from the serial stream at a time (max 255), 0 selects the byte-at-a-time decoder */
+#endif
+
+#ifndef ELCLIENT_RX_SLOTS
+#define ELCLIENT_RX_SLOTS 1 /**< Number of receive buffers (max 8), packets can be held with Acquire() while the other slots keep receiving */
+#endif
+
+#ifndef ELCLIENT_MAX_PENDING
+#define ELCLIENT_MAX_PENDING 4 /**< Number of requests that can wait for a CMD_RESP_V at the same time */
+#endif
+
+#ifndef ELCLIENT_TRACE_SIZE
+#ifdef __AVR__
+#define ELCLIENT_TRACE_SIZE 0 /**< Number of records in the binary trace ring (max 255), 0 compiles tracing out */
+#else
+#define ELCLIENT_TRACE_SIZE 32 /**< Number of records in the binary trace ring (max 255), 0 compiles tracing out */
+#endif
+#endif
+
+#ifndef ELCLIENT_STATS
+#define ELCLIENT_STATS 1 /**< Count traffic, errors and round-trip times in ELClientStats, 0 compiles the counting out */
+#endif
+
+#ifndef ELCLIENT_LATENCY_BUCKETS
+#define ELCLIENT_LATENCY_BUCKETS 12 /**< Number of log2 buckets of the round-trip time histogram in ELClientStats */
+#endif
+
+#ifndef ELCLIENT_MAX_CALLBACKS
+#define ELCLIENT_MAX_CALLBACKS 16 /**< Number of callbacks that can be registered for esp-link to call: the wifiCb takes one, ELClientMqtt four, each ELClientRest and ELClientSocket one */
+#endif
+
+// Callbacks are identified on the wire by handles instead of their addresses. The handles are
+// small and dense so dispatching is an array lookup, they start at ELC_HANDLE_BASE so they do not
+// look like the values that usual responses carry.
+#define ELC_HANDLE_BASE 0xEC00 /**< Wire value of callback handle 0, which is never handed out */
+#define ELC_HANDLE_WIFI (ELC_HANDLE_BASE + 1) /**< Handle of the wifiCb, sent with CMD_SYNC */
+
+#ifndef ELCLIENT_MAX_SERVICES
+#define ELCLIENT_MAX_SERVICES 2 /**< Number of services that can be registered with AddService for Process() to call */
+#endif
+
+#ifndef ELCLIENT_STREAM_SINKS
+#define ELCLIENT_STREAM_SINKS 2 /**< Number of stream sinks that can be registered with SetStreamSink, 0 compiles streaming out */
+#endif
+
+#ifndef ELCLIENT_SYNC_PROBE_MS
+#define ELCLIENT_SYNC_PROBE_MS 50 /**< Interval in milliseconds between sync probes while waiting for esp-link */
+#endif
+
+#ifndef ELCLIENT_AUTO_RESYNC
+#define ELCLIENT_AUTO_RESYNC 0 /**< Resynchronize automatically when the received traffic suggests that esp-link was reset; the sketch must then set up its callbacks again from syncCb */
+#endif
+
+#ifndef ELCLIENT_RESET_ERRORS
+#define ELCLIENT_RESET_ERRORS 5 /**< Number of bad frames (CRC errors, runts) that are taken as an esp-link reset */
+#endif
+
+#ifndef ELCLIENT_RESET_WINDOW_MS
+#define ELCLIENT_RESET_WINDOW_MS 500 /**< Time window in milliseconds for counting ELCLIENT_RESET_ERRORS */
+#endif
+
 // Enumeration of commands supported by esp-link, this needs to match the definition in
 // esp-link!
 typedef enum {
@@ -30,6 +112,9 @@ typedef enum {
   CMD_MQTT_PUBLISH,    /**< Publish MQTT topic */
   CMD_MQTT_SUBSCRIBE,  /**< Subscribe to MQTT topic */
   CMD_MQTT_LWT,        /**< Define MQTT last will */
+  //CMD_MQTT_GET_CLIENTID,
+  CMD_MQTT_TOPIC = 15, /**< Register a topic alias for CMD_MQTT_PUBLISH_ID (needs esp-link support) */
+  CMD_MQTT_PUBLISH_ID, /**< Publish MQTT message to a topic alias (needs esp-link support) */
 
   CMD_REST_SETUP = 20, /**< Setup REST connection */
   CMD_REST_REQUEST,    /**< Make request to REST server */
@@ -56,16 +141,125 @@ typedef struct {
   uint16_t bufSize;
   uint16_t dataLen;
   uint8_t isEsc;
+  uint8_t overflow; /**< The frame did not fit into buf and is dropped at its end */
 } ELClientProtocol; /**< Protocol structure  */
 
+typedef enum {
+  ELC_PENDING_UNKNOWN = 0, /**< Token is not (or no longer) in the pending-request table */
+  ELC_PENDING_WAIT,        /**< Still waiting for the response */
+  ELC_PENDING_DONE,        /**< Response received, value is valid */
+  ELC_PENDING_TIMEOUT      /**< No response within the timeout */
+} ELClientPendingState; /**< State of a request in the pending-request table */
+
+typedef struct {
+  uint8_t  token;   /**< Token handed out by Expect, 0 if the entry is free */
+  uint8_t  state;   /**< ELClientPendingState */
+  uint32_t value;   /**< Value of the CMD_RESP_V response */
+  uint32_t start;   /**< millis() when the request was registered */
+  uint32_t timeout; /**< Timeout in milliseconds */
+  uint8_t  late;    /**< Timed out but the response may still come, it is dropped when it does */
+  uint8_t  shadowed; /**< A late response was dropped while waiting, it may have been this one's */
+  FP<void, void*> *cb;     /**< Called with the entry when the request completes, set by the library class that sent it */
+  FP<void, void*> *userCb; /**< Called with the entry after cb, set with ELClientFuture::then */
+} ELClientPending; /**< Entry of the pending-request table */
+
+typedef enum {
+  ELC_SYNC_IDLE = 0, /**< No sync was started yet */
+  ELC_SYNC_WAIT,     /**< Probing esp-link and waiting for the wifiCb handle echo */
+  ELC_SYNC_DONE,     /**< Synchronized */
+  ELC_SYNC_FAILED    /**< esp-link did not answer within the timeout */
+} ELClientSyncState; /**< State of the synchronization with esp-link */
+
+typedef enum {
+  ELC_TRACE_RX = 1,   /**< Frame received, len is the frame length, flags ELC_TRACE_CRC_OK */
+  ELC_TRACE_TX,       /**< Request sent, len is the number of bytes on the wire */
+  ELC_TRACE_RUNT,     /**< Frame shorter than a packet header */
+  ELC_TRACE_OVERFLOW, /**< Frame longer than the receive buffer */
+  ELC_TRACE_TIMEOUT,  /**< Pending request timed out, len is its token */
+  ELC_TRACE_SYNC,     /**< Sync completed, len is the new sync epoch */
+  ELC_TRACE_RESET,    /**< esp-link reset detected, resync started */
+  ELC_TRACE_APP       /**< Recorded by a library class, e.g. REST status or socket data */
+} ELClientTraceEvent; /**< Event types of the binary trace */
+
+#define ELC_TRACE_CRC_OK 0x01 /**< Flag of ELC_TRACE_RX: the CRC was correct */
+#define ELC_TRACE_LATE 0x01 /**< Flag of ELC_TRACE_TIMEOUT: the late response arrived and was dropped */
+
+typedef struct PACKED {
+  uint32_t time;  /**< micros() when the event was recorded */
+  uint8_t event;  /**< ELClientTraceEvent */
+  uint8_t flags;  /**< Event specific flags */
+  uint16_t cmd;   /**< Command of the frame */
+  uint16_t len;   /**< Event specific length or value */
+} ELClientTraceRecord; /**< Record of the binary trace, dumped as is by DumpTrace */
+
+typedef struct {
+  uint32_t framesIn;  /**< Frames received with a correct CRC */
+  uint32_t framesOut; /**< Requests sent */
+  uint32_t bytesIn;   /**< Bytes received, as they come over the serial line */
+  uint32_t bytesOut;  /**< Bytes sent, as they go over the serial line */
+  uint16_t crcErrors; /**< Frames dropped because of an invalid CRC */
+  uint16_t overflows; /**< Frames dropped because they did not fit into the receive buffer */
+  uint16_t runts;     /**< Frames dropped because they were shorter than a packet header */
+  uint16_t unhandled; /**< Frames with a command that nobody handles */
+  uint16_t timeouts;  /**< Pending requests that got no response in time */
+  // Round-trip times of requests registered with Expect, latency[0] counts responses within the
+  // same millisecond, latency[i] those taking 2^(i-1) to 2^i-1 ms, the last bucket everything longer
+  uint16_t latency[ELCLIENT_LATENCY_BUCKETS]; /**< Round-trip time histogram */
+} ELClientStats; /**< Link statistics, see ELClient::GetStats */
+
+typedef enum {
+  ELC_STREAM_DATA = 0, /**< data holds the next bytes of an argument */
+  ELC_STREAM_END,      /**< The frame is complete and its CRC was correct */
+  ELC_STREAM_ERROR     /**< The frame is bad (CRC error or truncated), drop what was received */
+} ELClientStreamState; /**< Kind of an ELClientStreamChunk */
+
+typedef struct {
+  uint8_t state;         /**< ELClientStreamState */
+  ELClientPacket* packet; /**< Header of the frame (cmd, argc, value), no arguments follow it */
+  uint16_t arg;          /**< Index of the argument the data belongs to */
+  uint16_t argLen;       /**< Total length of that argument */
+  uint16_t offset;       /**< Offset of data within the argument */
+  const uint8_t* data;   /**< Argument bytes, valid during the call only */
+  uint16_t len;          /**< Number of bytes in data */
+} ELClientStreamChunk; /**< Piece of a streamed frame handed to a stream sink */
+
+typedef struct {
+  uint16_t cmd;          /**< Command of the frames to stream */
+  uint32_t value;        /**< Value of the frames to stream, 0 for any */
+  FP<void, void*> *sink; /**< Called with an ELClientStreamChunk pointer, NULL if the entry is free */
+} ELClientStreamSink; /**< Entry of the stream sink table */
+
+typedef struct {
+  const void* data; /**< Pointer to the bytes */
+  uint16_t len;     /**< Number of bytes */
+} ELClientSpan; /**< Block of bytes in RAM passed to ELClient::send, see ELClient::span */
+
+typedef struct {
+  const __FlashStringHelper* data; /**< Pointer to the bytes in flash */
+  uint16_t len;                    /**< Number of bytes */
+} ELClientSpanP; /**< Block of bytes in flash passed to ELClient::send, see ELClient::span */
+
+template<class T> struct ELClientIsPointer { enum { value = 0 }; }; /**< Rejects pointers as fixed-size send arguments */
+template<class T> struct ELClientIsPointer<T*> { enum { value = 1 }; }; /**< Rejects pointers as fixed-size send arguments */
+
+template<class T> class ELClientFuture;
+
 typedef uint8_t (*CallbackPacketHandler)(ELClientPacket *); /**< Typedef for web-server packet handler callback function */
 
+// With ELCLIENT_NO_HEAP defined the library never calls malloc or new. The receive slots and
+// web server handlers must then come from ELClientStatic and ELClientWebServerStatic.
+
 class ELClient {
   public:
+#ifndef ELCLIENT_NO_HEAP
     // Create an esp-link client based on a stream and with a specified debug output stream.
     ELClient(Stream* serial, Stream* debug);
     // Create an esp-link client based on a stream with no debug output
     ELClient(Stream* serial);
+#endif
+    // Create an esp-link client that receives into caller storage of ELCLIENT_RX_SLOTS buffers of
+    // rxSize bytes each instead of the heap, debug may be NULL. See ELClientStatic.
+    ELClient(Stream* serial, Stream* debug, uint8_t* rxStorage, uint16_t rxSize);
 
     Stream* _debug; /**< Data stream for debug use */
 
@@ -80,6 +274,28 @@ class ELClient {
     void Request(const __FlashStringHelper* data, uint16_t len);
     // Finish a request
     void Request(void);
+    // Send a complete request, argc is the number of args. Strings (RAM or F()) are sent without
+    // the terminating 0, ELClient::span(data, len) sends a block of bytes and any other argument is
+    // sent as a fixed-size value, e.g. send(CMD_MQTT_SUBSCRIBE, 0, topic, qos)
+    template<typename... Args>
+    void send(uint16_t cmd, uint32_t value, const Args&... args) {
+      Request(cmd, value, sizeof...(Args));
+      sendArgs(args...);
+      Request();
+    }
+    // Send a request that was encoded at compile time, e.g. sendFrame<ELClientFrame<CMD_GET_TIME, 0> >()
+    template<class Frame>
+    void sendFrame(void) { writeFrame_P(Frame::bytes, Frame::size); }
+    // Wrap a block of bytes as an argument for send
+    static ELClientSpan span(const void* data, uint16_t len) {
+      ELClientSpan s = { data, len };
+      return s;
+    }
+    // Wrap a block of bytes in flash as an argument for send
+    static ELClientSpanP span(const __FlashStringHelper* data, uint16_t len) {
+      ELClientSpanP s = { data, len };
+      return s;
+    }
 
     //== Responses
     // Process the input stream, call this in loop() to dispatch call-back based responses.
@@ -87,38 +303,258 @@ class ELClient {
     // Returns the ELClientPacket if a non-callback response was received, typically this is
     // used to create an ELClientResponse. Returns NULL if no response needs to be processed.
     ELClientPacket *Process(void);
+    // Process with a budget: return after maxMicros microseconds or maxBytes received bytes,
+    // 0 means no limit. The remaining input is handled by the next call.
+    ELClientPacket *Process(uint32_t maxMicros, uint16_t maxBytes);
+    // Counters of the link traffic and errors since the start or ResetStats
+    const ELClientStats& GetStats(void) { return _stats; }
+    // Zero all counters of GetStats
+    void ResetStats(void);
+    // Time spent in the last call of Process, in microseconds
+    uint32_t ProcessMicros(void) { return _procLast; }
+    // Longest time spent in a call of Process since ResetProcessStats, in microseconds
+    uint32_t ProcessMaxMicros(void) { return _procMax; }
+    // Restart the ProcessMaxMicros statistic
+    void ResetProcessStats(void) { _procMax = 0; }
     // Busy wait for a response with a timeout in milliseconds, returns an ELClientPacket
     // if a response was recv'd and NULL otherwise. The ELClientPacket is typically used to
     // create an ELClientResponse.
     ELClientPacket *WaitReturn(uint32_t timeout=ESP_TIMEOUT);
 
+    //== Pending requests
+    // esp-link answers requests in the order it receives them, so each CMD_RESP_V is routed to
+    // the oldest request registered with Expect instead of being returned by Process. A request
+    // that timed out keeps its place until its late response is dropped or a new request is
+    // registered, so do not wait for responses with a raw WaitReturn while requests registered
+    // with Expect are outstanding.
+    // Register the request just sent as waiting for a CMD_RESP_V. Returns a token for Poll, or
+    // 0 if the pending-request table is full (the response is then returned by Process).
+    // The optional cb is called from Process with the ELClientPending entry when it completes.
+    uint8_t Expect(uint32_t timeout=ESP_TIMEOUT, FP<void, void*> *cb=NULL);
+    // Check on a pending request, returns an ELClientPendingState and stores the response value
+    // if it is ELC_PENDING_DONE. Finished entries stay in the table until Expect needs the room.
+    uint8_t Poll(uint8_t token, uint32_t *value);
+    // Have cb called with the ELClientPending entry once the request completes, right away if it
+    // already has. Returns false if the token is unknown.
+    boolean Then(uint8_t token, FP<void, void*> *cb);
+    // Run Process until the pending request is done or timed out, returns true and stores the
+    // response value if it is done
+    boolean WaitFor(uint8_t token, uint32_t *value);
+    // Stop waiting for a pending request, its CMD_RESP_V is then returned by Process as if
+    // Expect had not been called. Returns false if the request is not waiting.
+    boolean Cancel(uint8_t token);
+
     //== Commands built-into ELClient
     // Initialize and synchronize communication with esp-link with a timeout in milliseconds,
     // and remove all existing callbacks. Registers the wifiCb and returns true on success
     boolean Sync(uint32_t timeout=ESP_TIMEOUT);
-    // Request the wifi status
-    void GetWifiStatus(void);
+    // Start synchronizing without blocking, a sync probe is sent every ELCLIENT_SYNC_PROBE_MS
+    // until esp-link echoes the wifiCb handle or the timeout in milliseconds expires
+    void SyncStart(uint32_t timeout=ESP_TIMEOUT);
+    // Process input and return the ELClientSyncState, call it until it is no longer ELC_SYNC_WAIT
+    uint8_t SyncPoll(void);
+    // The current ELClientSyncState, an automatic resync puts it back to ELC_SYNC_WAIT
+    uint8_t SyncState(void) { return _syncState; }
+    // Incremented on every completed sync, esp-link forgets all callbacks when it syncs so
+    // MQTT, REST and socket set-ups have to be repeated when the epoch changes
+    uint8_t SyncEpoch(void) { return _syncEpoch; }
+    // Request the wifi status, the returned future completes with a WIFI_STATUS value
+    ELClientFuture<uint8_t> GetWifiStatus(void);
     
     CallbackPacketHandler GetCallbackPacketHandler() { return callbackPacketHandler; } 
     void SetCallbackPacketHandler( CallbackPacketHandler cbph ) { callbackPacketHandler = cbph; }
     void SetReceiveBufferSize(uint16_t size);
+    // Keep a received packet valid while further frames are processed, needs ELCLIENT_RX_SLOTS > 1.
+    // Returns false if no slot is left to receive into.
+    boolean Acquire(ELClientPacket *packet);
+    // Release a packet held with Acquire
+    void Release(ELClientPacket *packet);
+    // Stream frames with the given command and value (0 for any value) to sink instead of
+    // receiving them into the receive buffer. The sink is called with ELClientStreamChunk
+    // pointers as the argument bytes arrive, then once with ELC_STREAM_END or ELC_STREAM_ERROR
+    // when the CRC was checked. A NULL sink removes the entry. Returns false if the table is full.
+    boolean SetStreamSink(uint16_t cmd, uint32_t value, FP<void, void*> *sink);
+    // Receive from a ring filled by an RX interrupt instead of polling the serial stream,
+    // NULL switches back to the stream. Requests are still sent on the serial stream.
+    void SetReceiveRing(ELClientRing *ring) { _ring = ring; }
+
+    //== Trace
+    // Add a record to the binary trace ring, costs a few stores; a no-op if ELCLIENT_TRACE_SIZE is 0
+#if ELCLIENT_TRACE_SIZE > 0
+    void Trace(uint8_t event, uint8_t flags, uint16_t cmd, uint16_t len) {
+      ELClientTraceRecord *r = &_trace[_traceHead];
+      r->time = micros();
+      r->event = event;
+      r->flags = flags;
+      r->cmd = cmd;
+      r->len = len;
+      if (++_traceHead == ELCLIENT_TRACE_SIZE) _traceHead = 0;
+      if (_traceCount < ELCLIENT_TRACE_SIZE) _traceCount++;
+    }
+#else
+    void Trace(uint8_t, uint8_t, uint16_t, uint16_t) {}
+#endif
+    // Write the trace records, oldest first, in binary to a stream (see extras/eltrace.py)
+    void DumpTrace(Stream* out);
+    // Drop all trace records
+    void ClearTrace(void);
+
+    //== Callback handles
+    // Get the handle to send to esp-link for a callback, registering it on first use. The same
+    // callback always gets the same handle. Returns 0 if the table (ELCLIENT_MAX_CALLBACKS) is full.
+    uint32_t Handle(FP<void, void*> *cb);
+    // Remove a callback from the table, esp-link responses to its handle are dropped afterwards
+    void ReleaseHandle(FP<void, void*> *cb);
+
+    //== Services
+    // Register a callback that Process() calls with the ELClient after handling the input, for
+    // library classes that send queued requests in the background. Registering the same callback
+    // again does nothing. Returns false if ELCLIENT_MAX_SERVICES are already registered.
+    boolean AddService(FP<void, void*> *service);
+    // Stop calling a service
+    void RemoveService(FP<void, void*> *service);
 
     // Callback for wifi status changes that must be attached before calling Sync
     FP<void, void*> wifiCb; /**< Pointer to external callback function */
+    // Callback called with the ELClient whenever a sync completes, including automatic resyncs
+    FP<void, void*> syncCb; /**< Pointer to external callback function */
 
   //private:
     Stream* _serial; /**< Serial stream for communication with ESP */
+    ELClientRing* _ring; /**< Receive ring set with SetReceiveRing, NULL to read _serial */
     boolean _debugEn; /**< Flag for debug - True = enabled, False = disabled */
     uint16_t crc; /**< CRC checksum */
-    ELClientProtocol _proto; /**< Protocol structure */
+    ELClientProtocol _proto; /**< Protocol structure, _proto.buf is the receive slot in use */
+    uint8_t* _rxSlots[ELCLIENT_RX_SLOTS]; /**< Receive slots */
+    uint8_t _rxHeld; /**< Bit mask of the receive slots held with Acquire */
     CallbackPacketHandler callbackPacketHandler; /**< Packet handler for web server */
+    FP<void, void*> *_callbacks[ELCLIENT_MAX_CALLBACKS]; /**< Callback of each handle, index is handle - ELC_HANDLE_BASE - 1 */
+    ELClientPending _pending[ELCLIENT_MAX_PENDING]; /**< Pending-request table */
+    uint8_t _pendingToken; /**< Last token handed out by Expect */
+    uint8_t _pendingWait; /**< Number of entries in ELC_PENDING_WAIT state */
+    uint8_t _pendingLate; /**< Number of timed out entries whose response may still come */
+    boolean pendingResolve(uint32_t value);
+    void pendingExpire(void);
+    void pendingClear(void);
+    void pendingDone(ELClientPending *entry);
+    uint8_t _syncState; /**< ELClientSyncState */
+    uint8_t _syncEpoch; /**< Number of completed syncs, 0 = never synced */
+    uint8_t _syncProbes; /**< Sync probes that esp-link has not answered yet */
+    boolean _syncAuto; /**< Sync was started by the reset detection and keeps probing */
+    uint32_t _syncStart; /**< millis() when the sync was started */
+    uint32_t _syncSent; /**< millis() when the last probe was sent */
+    uint32_t _syncTimeout; /**< Sync timeout in milliseconds */
+    uint8_t _rxErrors; /**< Bad frames counted in the current reset detection window */
+    uint32_t _rxErrorAt; /**< millis() when the reset detection window started */
+    boolean _resyncDue; /**< The reset detection fired, Process() starts the resync */
+    void syncProbe(void);
+    void syncTick(void);
+    void syncDone(void);
+    void rxError(void);
+    void resync(void);
+
+    ELClientStats _stats; /**< Link statistics */
+    void statLatency(uint32_t ms);
+    uint32_t _procLast; /**< Time spent in the last Process call in microseconds */
+    uint32_t _procMax; /**< Longest Process call in microseconds */
+    FP<void, void*> *_services[ELCLIENT_MAX_SERVICES]; /**< Services called by Process */
+    boolean _serviceBusy; /**< A service is running, Process called from it does not run them again */
+    void runServices(void);
+    ELClientPacket *processInput(uint32_t start, uint32_t maxMicros, uint16_t maxBytes);
 
-    void init();
+    uint16_t _rxStatic; /**< Size of each receive slot in caller storage, 0 if the slots are on the heap */
+    void init(uint8_t* rxStorage, uint16_t rxSize);
     void DBG(const char* info);
     ELClientPacket *protoCompletedCb(void);
+#if ELCLIENT_RX_BLOCK_SIZE > 0
+    uint8_t _rxBlock[ELCLIENT_RX_BLOCK_SIZE]; /**< Block of raw bytes read from the serial stream */
+    uint8_t _rxPos; /**< Next byte to decode in _rxBlock */
+    uint8_t _rxEnd; /**< Number of bytes in _rxBlock */
+    ELClientPacket *protoDecodeBlock(uint8_t end);
+#endif
+    void protoAppend(const uint8_t* data, uint16_t len);
+#if ELCLIENT_STREAM_SINKS > 0
+    ELClientStreamSink _streamSinks[ELCLIENT_STREAM_SINKS]; /**< Stream sink table */
+    ELClientStreamSink* _streamSink; /**< Sink of the frame being streamed, NULL if not streaming */
+    uint16_t _streamCrc; /**< CRC of the streamed bytes so far */
+    uint16_t _streamLen; /**< Number of bytes streamed so far, after the header */
+    uint16_t _streamArg; /**< Argument being streamed */
+    uint16_t _streamArgLen; /**< Length of that argument */
+    uint16_t _streamPos; /**< Bytes of that argument delivered so far */
+    uint8_t _streamHdr; /**< Bytes of the argument length received so far (0..2) */
+    uint8_t _streamPad; /**< Padding bytes left after the argument */
+    void streamBegin(void);
+    void streamAppend(const uint8_t* data, uint16_t len);
+    void streamFlush(uint16_t end);
+    void streamEnd(void);
+    void streamChunk(uint8_t state, const uint8_t* data, uint16_t len);
+#endif
+    ELClientPacket *protoFrameEnd(void);
+    uint8_t _txBuf[ELCLIENT_TX_BUFFER_SIZE]; /**< Staging buffer for SLIP encoded output */
+    uint8_t _txLen; /**< Number of bytes in _txBuf */
     void write(uint8_t data);
     void write(void* data, uint16_t len);
-    uint16_t crc16Add(unsigned char b, uint16_t acc);
-    uint16_t crc16Data(const unsigned char *data, uint16_t len, uint16_t acc);
+    void writeArg(const uint8_t* data, uint16_t len, uint8_t pad);
+    void txPut(uint8_t data) {
+      if (_txLen == ELCLIENT_TX_BUFFER_SIZE) txFlush();
+      _txBuf[_txLen++] = data;
+    } /**< Append a raw byte to the staging buffer */
+    void txFlush(void);
+    void writeFrame_P(const uint8_t* frame, uint16_t len);
+    void writeEncoded(const uint8_t* data, uint16_t len, uint16_t acc);
+#if ELCLIENT_TRACE_SIZE > 0
+    ELClientTraceRecord _trace[ELCLIENT_TRACE_SIZE]; /**< Trace ring */
+    uint8_t _traceHead; /**< Next record to write */
+    uint8_t _traceCount; /**< Number of valid records */
+    uint16_t _txCmd; /**< Command of the request being written */
+    uint16_t _txFrameLen; /**< Bytes of the request written so far */
+#endif
+    void sendArgs(void) {} /**< End of the send argument list */
+    template<typename T, typename... Rest>
+    void sendArgs(const T& arg, const Rest&... rest) {
+      sendArg(arg);
+      sendArgs(rest...);
+    } /**< Write the send arguments in order */
+    void sendArg(const ELClientSpan& arg) { Request(arg.data, arg.len); } /**< Block of bytes */
+    void sendArg(const ELClientSpanP& arg) { Request(arg.data, arg.len); } /**< Block of bytes in flash */
+    void sendArg(const char* arg) { Request(arg, strlen(arg)); } /**< String */
+    void sendArg(char* arg) { Request(arg, strlen(arg)); } /**< String */
+    template<size_t N>
+    void sendArg(const char (&arg)[N]) { Request(arg, strlen(arg)); } /**< String in a char array */
+    void sendArg(const __FlashStringHelper* arg) { Request(arg, strlen_P((const char*)arg)); } /**< String in flash */
+    template<typename T>
+    void sendArg(const T& arg) {
+      static_assert(!ELClientIsPointer<T>::value, "pass pointers to send as ELClient::span(data, len)");
+      // length, value and padding are laid out at compile time and written in one go
+      uint8_t buf[2 + sizeof(T) + ((4 - (sizeof(T) & 3)) & 3)] = { sizeof(T) & 0xFF, sizeof(T) >> 8 };
+      memcpy(buf + 2, &arg, sizeof(T));
+      writeArg(buf, sizeof(buf), 0);
+    } /**< Fixed-size value */
+    static uint16_t crc16Add(unsigned char b, uint16_t acc);
+    static uint16_t crc16Data(const unsigned char *data, uint16_t len, uint16_t acc);
+    // The individual CRC engines, crc16Data uses the one selected by ELCLIENT_CRC_ENGINE
+    static uint16_t crc16DataBitwise(const unsigned char *data, uint16_t len, uint16_t acc);
+    static uint16_t crc16DataTable(const unsigned char *data, uint16_t len, uint16_t acc);
+    static uint16_t crc16DataSlice4(const unsigned char *data, uint16_t len, uint16_t acc);
 };
+
+// An ELClient whose receive slots are part of the object, so it works without any heap, e.g.
+//   ELClientStatic<128> esp(&Serial);
+// RxSize is the size of each of the ELCLIENT_RX_SLOTS receive buffers, SetReceiveBufferSize can
+// only shrink it.
+template<uint16_t RxSize>
+class ELClientStatic : public ELClient {
+  public:
+    // Create an esp-link client based on a stream with no debug output
+    ELClientStatic(Stream* serial) : ELClient(serial, NULL, _rxStorage[0], RxSize) {}
+    // Create an esp-link client based on a stream and with a specified debug output stream
+    ELClientStatic(Stream* serial, Stream* debug) : ELClient(serial, debug, _rxStorage[0], RxSize) {}
+
+  private:
+    static_assert(RxSize >= 16, "ELClientStatic needs a receive buffer of at least 16 bytes");
+    uint8_t _rxStorage[ELCLIENT_RX_SLOTS][RxSize]; /**< Receive slots */
+};
+
+#include "ELClientFuture.h"
+
 #endif // _EL_CLIENT_H_
@@ -18,21 +18,25 @@ ELClientCmd::ELClientCmd(ELClient* elc) :_elc(elc) {}
 @details Time from the ESP is unformated value of seconds
 @warning If the ESP cannot connect to the NTP server or the connection NTP server is not setup, 
 	then this time is the number of seconds since the last reboot of the ESP
-@return <code>uint32_t</code>
-	current time as number of seconds
+@return <code>ELClientFuture<uint32_t></code>
+	completes with the current time as number of seconds, 0 if esp-link does not answer
 	- since Thu Jan  1 00:00:58 UTC 1970 if ESP has time from NTP
 	- since last reboot of ESP if no NTP time is available
 @par Example
 @code
-	uint32_t t = cmd.GetTime();
+	uint32_t t = cmd.GetTime(); // waits for the answer
 	Serial.print("Time: "); Serial.println(t);
 @endcode
+@par Example non-blocking
+@code
+	ELClientFuture<uint32_t> t = cmd.GetTime();
+	// ... in loop()
+	if (t.ready()) { Serial.print("Time: "); Serial.println(t.value()); }
+@endcode
 */
-uint32_t ELClientCmd::GetTime() {
-  _elc->Request(CMD_GET_TIME, 0, 0);
-  _elc->Request();
+ELClientFuture<uint32_t> ELClientCmd::GetTime() {
+  _elc->sendFrame<ELClientFrame<CMD_GET_TIME, 0> >();
 
-  ELClientPacket *pkt = _elc->WaitReturn();
-  return pkt ? pkt->value : 0;
+  return ELClientFuture<uint32_t>(_elc, _elc->Expect());
 }
 
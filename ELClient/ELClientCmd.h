@@ -15,8 +15,9 @@ class ELClientCmd {
   public:
     // Constructor
     ELClientCmd(ELClient* elc);
-    // Get the current time in seconds since the epoch, 0 if the time is unknown
-    uint32_t GetTime();
+    // Get the current time in seconds since the epoch, 0 if the time is unknown. Converting the
+    // future to uint32_t waits for the answer
+    ELClientFuture<uint32_t> GetTime();
 
   private:
     ELClient* _elc; /**< ELClient instance */
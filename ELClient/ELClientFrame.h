@@ -0,0 +1,111 @@
+/*! \file ELClientFrame.h
+    \brief Definitions for ELClientFrame, requests that are SLIP encoded at compile time
+*/
+
+#ifndef _EL_CLIENT_FRAME_H_
+#define _EL_CLIENT_FRAME_H_
+
+#include <avr/pgmspace.h>
+#include <Arduino.h>
+
+// Requests made only of constants (a command, a constant value and at most one constant string
+// argument) are laid out, checksummed and SLIP escaped by the compiler. The encoded bytes are
+// stored in flash and ELClient::sendFrame writes them with a bulk copy, e.g.
+//   constexpr char webCbName[] = "webCb";
+//   _elc->sendFrame<ELClientFrame<CMD_CB_ADD, 100, webCbName> >();
+// Everything is written as C++11 constexpr functions (single return statements) so it builds
+// with the default Arduino toolchains.
+
+template<uint16_t... I> struct ELClientSeq {}; /**< Compile-time list of indices */
+
+template<uint16_t N, uint16_t... I>
+struct ELClientMakeSeq : ELClientMakeSeq<N - 1, N - 1, I...> {}; /**< Builds ELClientSeq<0 .. N-1> */
+template<uint16_t... I>
+struct ELClientMakeSeq<0, I...> { typedef ELClientSeq<I...> type; }; /**< Builds ELClientSeq<0 .. N-1> */
+
+constexpr uint16_t ELClientStrLen(const char* s) {
+  return s == nullptr || *s == 0 ? 0 : 1 + ELClientStrLen(s + 1);
+} /**< constexpr strlen, 0 for nullptr */
+
+template<const char* Arg>
+struct ELClientArgc { static constexpr uint16_t value = 1; }; /**< Number of arguments of a constant request */
+template<>
+struct ELClientArgc<nullptr> { static constexpr uint16_t value = 0; }; /**< A request without arguments */
+
+// Layout of a constant request: header, optional string argument with its length and padding.
+// Arg is nullptr for a request without arguments. The values that every byte depends on (Argc
+// and ArgLen here, the CRC and the encoded size below) are template parameters, so the compiler
+// computes each of them once and encoding a frame of n bytes costs O(n^2) constexpr steps.
+template<uint16_t Cmd, uint32_t Value, const char* Arg, uint16_t Argc, uint16_t ArgLen>
+struct ELClientFrameSpec {
+  static constexpr uint16_t argc() { return Argc; } /**< Number of arguments */
+  static constexpr uint16_t bodyLen() {
+    return 8 + (Argc ? 2 + ArgLen + ((4 - (ArgLen & 3)) & 3) : 0);
+  } /**< Bytes covered by the CRC */
+
+  static constexpr uint8_t body(uint16_t i) {
+    return i < 2 ? (uint8_t)(Cmd >> (8 * i)) :
+           i < 4 ? (uint8_t)(argc() >> (8 * (i - 2))) :
+           i < 8 ? (uint8_t)(Value >> (8 * (i - 4))) :
+           i < 10 ? (uint8_t)(ArgLen >> (8 * (i - 8))) :
+           i < 10 + ArgLen ? (uint8_t)Arg[i - 10] : 0;
+  } /**< Byte i of the request before the CRC */
+
+  // one step of ELClient::crc16Add (bitwise engine), split into single expressions
+  static constexpr uint16_t crcStep3(uint16_t a) { return a ^ ((a & 0xff00) >> 5); }
+  static constexpr uint16_t crcStep2(uint16_t a) { return crcStep3(a ^ ((a >> 8) >> 4)); }
+  static constexpr uint16_t crcStep1(uint16_t a) { return crcStep2(a ^ (uint16_t)((a & 0xff00) << 4)); }
+  static constexpr uint16_t crcAdd(uint8_t b, uint16_t acc) {
+    return crcStep1((uint16_t)(((acc ^ b) >> 8) | ((acc ^ b) << 8)));
+  } /**< constexpr crc16Add */
+  static constexpr uint16_t crc(uint16_t n, uint16_t acc) {
+    return n == bodyLen() ? acc : crc(n + 1, crcAdd(body(n), acc));
+  } /**< CRC of the body bytes from n on, acc is the CRC of the bytes before n */
+};
+
+// SLIP encoding of a request laid out by Spec, followed by its CRC
+template<class Spec, uint16_t Crc>
+struct ELClientFrameEnc {
+  static constexpr uint16_t rawLen() { return Spec::bodyLen() + 2; } /**< Body and CRC */
+  static constexpr uint8_t raw(uint16_t i) {
+    return i < Spec::bodyLen() ? Spec::body(i) : (uint8_t)(Crc >> (8 * (i - Spec::bodyLen())));
+  } /**< Byte i of the unescaped frame */
+
+  static constexpr uint8_t special(uint8_t c) { return c == 0300 || c == 0333; } /**< SLIP_END or SLIP_ESC */
+  static constexpr uint16_t escLen(uint16_t k) {
+    return k == rawLen() ? 0 : 1 + special(raw(k)) + escLen(k + 1);
+  } /**< Escaped length of raw bytes k .. rawLen()-1 */
+  static constexpr uint16_t size() { return escLen(0) + 2; } /**< Encoded frame with both SLIP_END */
+
+  static constexpr uint8_t escAt(uint16_t i, uint16_t k, uint16_t pos) {
+    return !special(raw(k)) ? (pos == i ? raw(k) : escAt(i, k + 1, pos + 1)) :
+           pos == i ? 0333 :
+           pos + 1 == i ? (raw(k) == 0300 ? 0334 : 0335) : escAt(i, k + 1, pos + 2);
+  } /**< Byte i of the escaped raw bytes, scanning from raw byte k at escaped position pos */
+  static constexpr uint8_t at(uint16_t i, uint16_t size) {
+    return i == 0 || i == size - 1 ? 0300 : escAt(i - 1, 0, 0);
+  } /**< Byte i of the encoded frame of the given size */
+};
+
+template<class Enc, class Seq> struct ELClientFrameData;
+template<class Enc, uint16_t... I>
+struct ELClientFrameData<Enc, ELClientSeq<I...> > {
+  static const uint8_t bytes[sizeof...(I)]; /**< Encoded frame in flash */
+}; /**< Storage of an encoded frame */
+template<class Enc, uint16_t... I>
+const uint8_t ELClientFrameData<Enc, ELClientSeq<I...> >::bytes[sizeof...(I)] PROGMEM = { Enc::at(I, sizeof...(I))... };
+
+template<uint16_t Cmd, uint32_t Value, const char* Arg>
+struct ELClientFrameTypes {
+  typedef ELClientFrameSpec<Cmd, Value, Arg, ELClientArgc<Arg>::value, ELClientStrLen(Arg)> Spec; /**< Layout */
+  typedef ELClientFrameEnc<Spec, Spec::crc(0, 0)> Enc; /**< Encoding */
+  typedef ELClientFrameData<Enc, typename ELClientMakeSeq<Enc::size()>::type> Data; /**< Flash storage */
+}; /**< Chains the compile-time stages of ELClientFrame */
+
+// A constant request. bytes is the complete SLIP frame in flash, size its length.
+template<uint16_t Cmd, uint32_t Value, const char* Arg = nullptr>
+struct ELClientFrame : ELClientFrameTypes<Cmd, Value, Arg>::Data {
+  static constexpr uint16_t size = ELClientFrameTypes<Cmd, Value, Arg>::Enc::size(); /**< Length of the encoded frame */
+};
+
+#endif // _EL_CLIENT_FRAME_H_
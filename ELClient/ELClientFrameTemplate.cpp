@@ -0,0 +1,213 @@
+/*! \file ELClientFrameTemplate.cpp
+    \brief Constructor and functions for ELClientFrameTemplate
+    \note Pre-encoded requests with patchable fields
+*/
+
+#include "ELClientFrameTemplate.h"
+
+#define SLIP_END  0300        /**< Indicates end of packet */
+#define SLIP_ESC  0333        /**< Indicates byte stuffing */
+#define SLIP_ESC_END  0334    /**< ESC ESC_END means END data byte */
+#define SLIP_ESC_ESC  0335    /**< ESC ESC_ESC means ESC data byte */
+
+/*! ELClientFrameTemplate(ELClient* elc, uint8_t* buf, uint16_t size)
+@brief Constructor for ELClientFrameTemplate
+@param elc
+	Pointer to ELClient instance
+@param buf
+	Buffer that holds the encoded request, it must stay valid while the template is used.
+	The constant part needs up to twice its length because of the escaping.
+@param size
+	Size of the buffer
+@par Example
+@code
+	uint8_t tempBuf[48];
+	ELClientFrameTemplate tempFrame(&esp, tempBuf, sizeof(tempBuf));
+@endcode
+*/
+ELClientFrameTemplate::ELClientFrameTemplate(ELClient* elc, uint8_t* buf, uint16_t size) :
+  _elc(elc), _buf(buf), _size(size), _prefixLen(0), _len(0), _prefixCrc(0), _fields(0), _ok(false) {}
+
+/*! begin(uint16_t cmd, uint32_t value, uint16_t argc)
+@brief Start building the request
+@details Drops a previously built request
+@param cmd
+	Command for the ESP, see enum CmdName for available commands
+@param value
+	First argument or pointer to a callback function
+@param argc
+	Number of arguments in this request
+@par Example
+@code
+	// same request as mqtt.publish("/sensor/temp", (uint8_t*)&temp, 4)
+	uint16_t len = 4;
+	uint8_t qos = 0, retain = 0;
+	tempFrame.begin(CMD_MQTT_PUBLISH, 0, 5);
+	tempFrame.arg("/sensor/temp");
+	uint8_t tempField = tempFrame.field(4);
+	tempFrame.arg(&len, 2);
+	tempFrame.arg(&qos, 1);
+	tempFrame.arg(&retain, 1);
+	tempFrame.end();
+@endcode
+*/
+void ELClientFrameTemplate::begin(uint16_t cmd, uint32_t value, uint16_t argc) {
+  ELClientPacket hdr;
+  hdr.cmd = cmd;
+  hdr.argc = argc;
+  hdr.value = value;
+
+  _len = 0;
+  _fields = 0;
+  _prefixCrc = 0;
+  _ok = _size > 0;
+  if (_ok) _buf[_len++] = SLIP_END;
+  put((const uint8_t*)&hdr, 8);
+}
+
+/*! arg(const void* data, uint16_t len)
+@brief Add a constant argument
+@param data
+	Pointer to the argument
+@param len
+	Length of the argument
+*/
+void ELClientFrameTemplate::arg(const void* data, uint16_t len) {
+  static const uint8_t zero[3] = { 0, 0, 0 };
+  put((const uint8_t*)&len, 2);
+  put((const uint8_t*)data, len);
+  put(zero, (4-(len&3))&3);
+}
+
+/*! field(uint16_t len)
+@brief Add a variable argument
+@details The field starts out zeroed, its content is set with set()
+@param len
+	Length of the argument
+@return <code>uint8_t</code>
+	Field number for set(), 0xFF if the field table is full
+*/
+uint8_t ELClientFrameTemplate::field(uint16_t len) {
+  static const uint8_t zero[3] = { 0, 0, 0 };
+  if (_fields == ELCLIENT_FRAME_FIELDS) {
+    _ok = false;
+    return 0xFF;
+  }
+  put((const uint8_t*)&len, 2);
+  if (_fields == 0) _prefixLen = _len; // the unescaped tail starts here
+  uint8_t f = _fields++;
+  _fieldOff[f] = _len;
+  _fieldLen[f] = len;
+  while (len > 0) {
+    uint16_t n = len > sizeof(zero) ? sizeof(zero) : len;
+    put(zero, n);
+    len -= n;
+  }
+  put(zero, (4-(_fieldLen[f]&3))&3);
+  return f;
+}
+
+/*! end(void)
+@brief Finish building the request
+@return <code>boolean</code>
+	True if the request is ready to be sent, false if the buffer or the field table was too small
+*/
+boolean ELClientFrameTemplate::end(void) {
+  if (_fields == 0) _prefixLen = _len;
+  return _ok;
+}
+
+/*! put(const uint8_t* data, uint16_t len)
+@brief Append bytes to the request
+@details Bytes before the first field are SLIP escaped and added to the prefix CRC, later bytes are
+	stored as they are
+@note Internal library function
+@param data
+	Pointer to the bytes
+@param len
+	Number of bytes
+*/
+void ELClientFrameTemplate::put(const uint8_t* data, uint16_t len) {
+  if (!_ok) return;
+  if (_fields > 0) {
+    if (_size - _len < len) {
+      _ok = false;
+      return;
+    }
+    memcpy(_buf + _len, data, len);
+    _len += len;
+    return;
+  }
+  _prefixCrc = ELClient::crc16Data(data, len, _prefixCrc);
+  while (len--) {
+    uint8_t c = *data++;
+    boolean esc = c == SLIP_END || c == SLIP_ESC;
+    if (_size - _len < (uint16_t)(1 + esc)) {
+      _ok = false;
+      return;
+    }
+    if (esc) {
+      _buf[_len++] = SLIP_ESC;
+      c = c == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+    }
+    _buf[_len++] = c;
+  }
+}
+
+/*! set(uint8_t field, const void* data)
+@brief Change the content of a field
+@param field
+	Field number returned by field()
+@param data
+	Pointer to the new content, as long as the field
+@par Example
+@code
+	uint32_t temp = readSensor();
+	tempFrame.set(tempField, temp);
+	tempFrame.send();
+@endcode
+*/
+void ELClientFrameTemplate::set(uint8_t field, const void* data) {
+  if (field >= _fields) return;
+  memcpy(_buf + _fieldOff[field], data, _fieldLen[field]);
+}
+
+/*! set(uint8_t field, const void* data, uint16_t len)
+@brief Change the content of a field, checking the length
+@details set(field, value) uses it with the size of the value, so a uint16_t written to a
+	4-byte field is rejected instead of sending 2 bytes of whatever follows it in memory.
+@param field
+	Field number returned by field()
+@param data
+	Pointer to the new content
+@param len
+	Length of data
+@return <code>boolean</code>
+	False if the field does not exist or len is not its length, the field is unchanged then
+@par Example
+@code
+	uint16_t level = analogRead(A0);
+	if (!levelFrame.set(levelField, &level, sizeof(level))) Serial.println("wrong field size");
+@endcode
+*/
+boolean ELClientFrameTemplate::set(uint8_t field, const void* data, uint16_t len) {
+  if (field >= _fields || len != _fieldLen[field]) return false;
+  memcpy(_buf + _fieldOff[field], data, len);
+  return true;
+}
+
+/*! send(void)
+@brief Send the request
+@details The escaped prefix is copied to the output as it is and the CRC continues from the cached
+	prefix CRC, only the bytes from the first field on are escaped and checksummed.
+@par Example
+@code
+	tempFrame.send();
+@endcode
+*/
+void ELClientFrameTemplate::send(void) {
+  if (!_ok) return;
+  _elc->writeEncoded(_buf, _prefixLen, _prefixCrc);
+  _elc->writeArg(_buf + _prefixLen, _len - _prefixLen, 0);
+  _elc->Request();
+}
@@ -0,0 +1,68 @@
+/*! \file ELClientFrameTemplate.h
+    \brief Definitions for ELClientFrameTemplate
+    \note Pre-encoded requests with patchable fields
+*/
+
+#ifndef _EL_CLIENT_FRAME_TEMPLATE_H_
+#define _EL_CLIENT_FRAME_TEMPLATE_H_
+
+#include <Arduino.h>
+#include "ELClient.h"
+
+#ifndef ELCLIENT_FRAME_FIELDS
+#define ELCLIENT_FRAME_FIELDS 4 /**< Maximum number of variable fields in an ELClientFrameTemplate */
+#endif
+
+// A request that is encoded once and sent many times with a few changed values, e.g. a periodic
+// publish of a sensor value to a fixed topic. Everything up to the first variable field is SLIP
+// escaped into the buffer once, together with its CRC. The rest is kept unescaped, fields are
+// patched in place with set() and send() escapes and checksums only that tail.
+class ELClientFrameTemplate {
+  public:
+    // The encoded request is kept in buf, which must stay valid while the template is used
+    ELClientFrameTemplate(ELClient* elc, uint8_t* buf, uint16_t size);
+
+    //== Building, same order as the Request calls
+    // Start the request
+    void begin(uint16_t cmd, uint32_t value, uint16_t argc);
+    // Add a constant argument
+    void arg(const void* data, uint16_t len);
+    // Add a constant string argument (without the terminating 0)
+    void arg(const char* str) { arg(str, strlen(str)); }
+    // Add a variable argument of len bytes, returns its field number for set()
+    uint8_t field(uint16_t len);
+    // Finish building, returns false if the buffer or the field table was too small
+    boolean end(void);
+
+    //== Use
+    // Copy the new content of a field, data must hold as many bytes as the field was declared with
+    void set(uint8_t field, const void* data);
+    // Copy the new content of a field, returns false and leaves the field as it is if len is not
+    // the length the field was declared with
+    boolean set(uint8_t field, const void* data, uint16_t len);
+    // Set a field to a fixed-size value, e.g. set(0, (uint32_t)reading). Returns false if the
+    // size of the value is not the length of the field. Pointers other than const void* would
+    // pick this overload and copy the address, so they are rejected.
+    template<typename T>
+    boolean set(uint8_t field, const T& value) {
+      static_assert(!ELClientIsPointer<T>::value, "pass pointers to set as (const void*)data");
+      return set(field, (const void*)&value, sizeof(T));
+    }
+    // Send the request with the current field contents
+    void send(void);
+
+  private:
+    ELClient* _elc; /**< ELClient instance */
+    uint8_t* _buf; /**< Escaped prefix followed by the unescaped tail */
+    uint16_t _size; /**< Size of _buf */
+    uint16_t _prefixLen; /**< Length of the escaped prefix, including the leading SLIP_END */
+    uint16_t _len; /**< Bytes used in _buf */
+    uint16_t _prefixCrc; /**< CRC of the unescaped prefix */
+    uint16_t _fieldOff[ELCLIENT_FRAME_FIELDS]; /**< Offset of each field in _buf */
+    uint16_t _fieldLen[ELCLIENT_FRAME_FIELDS]; /**< Length of each field */
+    uint8_t _fields; /**< Number of fields */
+    boolean _ok; /**< False once something did not fit */
+    void put(const uint8_t* data, uint16_t len);
+};
+
+#endif // _EL_CLIENT_FRAME_TEMPLATE_H_
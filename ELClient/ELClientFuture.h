@@ -0,0 +1,80 @@
+/*! \file ELClientFuture.h
+    \brief Definitions for ELClientFuture
+*/
+
+#ifndef _EL_CLIENT_FUTURE_H_
+#define _EL_CLIENT_FUTURE_H_
+
+#include "ELClient.h"
+
+// Handle to the result of a request that esp-link answers with a CMD_RESP_V. The request is
+// tracked in the ELClient pending-request table and completed from ELClient::Process, so the
+// caller can poll the future from loop() or attach a callback instead of blocking.
+// Converting the future to T waits for the result, which keeps code written for the blocking
+// API working, e.g. uint32_t t = cmd.GetTime();
+// A future that is dropped without being looked at, e.g. cmd.GetTime(); as a statement, does
+// what the call did before it returned a future: it waits for the result if the call used to
+// block, otherwise it cancels the pending request so the response goes to WaitReturn.
+template<class T>
+class ELClientFuture {
+  public:
+    // Created by the library class that sent the request. failValue is returned by value() if
+    // the request timed out. block tells what a dropped future does, see above.
+    ELClientFuture(ELClient* elc, uint8_t token, uint32_t failValue=0, boolean block=true) :
+      _elc(elc), _token(token), _value(failValue),
+      _state(token ? ELC_PENDING_WAIT : ELC_PENDING_UNKNOWN), _block(block), _used(false),
+      _owner(true) {}
+    // Copies take over the request, only the last copy acts on being dropped
+    ELClientFuture(const ELClientFuture& f) :
+      _elc(f._elc), _token(f._token), _value(f._value), _state(f._state), _block(f._block),
+      _used(f._used), _owner(f._owner) { f._owner = false; }
+    ELClientFuture& operator=(const ELClientFuture& f) {
+      if (this == &f) return *this;
+      drop();
+      _elc = f._elc; _token = f._token; _value = f._value; _state = f._state;
+      _block = f._block; _used = f._used; _owner = f._owner;
+      f._owner = false;
+      return *this;
+    }
+    ~ELClientFuture() { drop(); }
+
+    // True once the response arrived or the request timed out, does not block
+    boolean ready() { poll(); return _state != ELC_PENDING_WAIT; }
+    // True if the response arrived
+    boolean ok() { poll(); return _state == ELC_PENDING_DONE; }
+    // The ELClientPendingState of the request
+    uint8_t state() { poll(); return _state; }
+    // The result, or the failure value if the request did not complete (yet)
+    T value() { poll(); return (T)_value; }
+    // Busy wait for the result, calling ELClient::Process meanwhile
+    T wait() { while (!ready()) _elc->Process(); return value(); }
+    operator T() { return wait(); } /**< Wait for the result */
+    // Have cb called from ELClient::Process with the ELClientPending entry once the request
+    // completes (right away if it already has). The FP must stay valid until then.
+    boolean then(FP<void, void*> *cb) { _used = true; return _elc->Then(_token, cb); }
+    // The token of the request in the pending-request table
+    uint8_t token() { _used = true; return _token; }
+
+  private:
+    void poll() {
+      _used = true;
+      if (_state == ELC_PENDING_WAIT) _state = _elc->Poll(_token, &_value);
+    } /**< Update the state from the pending-request table */
+    void drop() {
+      if (!_owner) return;
+      _owner = false;
+      if (_used || _state != ELC_PENDING_WAIT) return;
+      if (_block) wait();
+      else _elc->Cancel(_token);
+    } /**< Act on a future that was dropped without being looked at */
+
+    ELClient* _elc; /**< ELClient instance */
+    uint8_t _token; /**< Token in the pending-request table */
+    uint32_t _value; /**< Response value once done */
+    uint8_t _state; /**< Last known ELClientPendingState */
+    boolean _block; /**< Wait for the result if dropped unused, otherwise cancel the request */
+    boolean _used; /**< The future was looked at */
+    mutable boolean _owner; /**< This copy acts on being dropped */
+};
+
+#endif // _EL_CLIENT_FUTURE_H_
@@ -19,32 +19,147 @@
 	ELClientMqtt(ELClient* elc);
 @endcode
 */
-ELClientMqtt::ELClientMqtt(ELClient* elc) :_elc(elc) {}
+ELClientMqtt::ELClientMqtt(ELClient* elc) :_elc(elc) {
+  _queue = NULL;
+  _queueSize = 0;
+  _queuePending = 0;
+  _queueNext = 0;
+  _queueInterval = 0;
+  _queueSent = 0;
+  _batches = NULL;
+  _routes = NULL;
+  _routeSize = 0;
+  _routeUsed = 0;
+  _routeFirst = ELC_ROUTE_NONE;
+  _connected = false;
+  _connEpoch = 0;
+  _store = NULL;
+  _storeInterval = 0;
+  _storeSent = 0;
+#if ELCLIENT_MQTT_TOPICS > 0
+  memset(_topics, 0, sizeof(_topics));
+  _topicsP = 0;
+  _topicEpoch = 0;
+#endif
+}
 
 /*! setup(void)
 @brief Setup mqtt
 @details Send callback functions for MQTT events to the ESP
+@return <code>boolean</code>
+	False if the ELClient callback table has no room for the callbacks (ELCLIENT_MAX_CALLBACKS),
+	nothing is sent then
 @par Example
 @code
 	mqtt.connectedCb.attach(mqttConnected);
 	mqtt.disconnectedCb.attach(mqttDisconnected);
 	mqtt.publishedCb.attach(mqttPublished);
 	mqtt.dataCb.attach(mqttData);
-	mqtt.setup();
+	if (!mqtt.setup()) Serial.println("MQTT setup failed");
 @endcode
 */
-void ELClientMqtt::setup(void) {
-  Serial.print(F("ConnectedCB is 0x")); Serial.println((uint32_t)&connectedCb, 16);
-  _elc->Request(CMD_MQTT_SETUP, 0, 4);
-  uint32_t cb = (uint32_t)&connectedCb;
-  _elc->Request(&cb, 4);
-  cb = (uint32_t)&disconnectedCb;
-  _elc->Request(&cb, 4);
-  cb = (uint32_t)&publishedCb;
-  _elc->Request(&cb, 4);
-  cb = (uint32_t)&dataCb;
-  _elc->Request(&cb, 4);
-  _elc->Request();
+boolean ELClientMqtt::setup(void) {
+  connCb.attach(this, &ELClientMqtt::connectedCallback);
+  discCb.attach(this, &ELClientMqtt::disconnectedCallback);
+  routeCb.attach(this, &ELClientMqtt::dataCallback);
+  uint32_t conn = _elc->Handle(&connCb);
+  uint32_t disc = _elc->Handle(&discCb);
+  uint32_t published = _elc->Handle(&publishedCb);
+  uint32_t data = _elc->Handle(&routeCb);
+  if (conn == 0 || disc == 0 || published == 0 || data == 0) return false;
+  _elc->send(CMD_MQTT_SETUP, 0, conn, disc, published, data);
+  return true;
+}
+
+/*! connectedCallback(void* res)
+@brief Called by esp-link when the broker got connected
+@note Internal library function
+@param res
+	Pointer to ELClientResponse structure, passed on to connectedCb
+*/
+void ELClientMqtt::connectedCallback(void* res) {
+  _connected = true;
+  _connEpoch = _elc->SyncEpoch();
+  if (connectedCb.attached()) connectedCb(res);
+}
+
+/*! disconnectedCallback(void* res)
+@brief Called by esp-link when the broker connection was lost
+@note Internal library function
+@param res
+	Pointer to ELClientResponse structure, passed on to disconnectedCb
+*/
+void ELClientMqtt::disconnectedCallback(void* res) {
+  _connected = false;
+  if (disconnectedCb.attached()) disconnectedCb(res);
+}
+
+/*! connected(void)
+@brief Check if esp-link is connected to the broker
+@details Follows the connected and disconnected callbacks of esp-link, so it is only known after
+	setup(). A resync with esp-link, e.g. after it reset, counts as disconnected until esp-link
+	reports the connection again.
+@return <code>boolean</code>
+	True if the broker is connected
+@par Example
+@code
+	if (!mqtt.connected()) digitalWrite(LED_BUILTIN, HIGH);
+@endcode
+*/
+boolean ELClientMqtt::connected(void) {
+  return _connected && _connEpoch == _elc->SyncEpoch() && _elc->SyncState() == ELC_SYNC_DONE;
+}
+
+// flags of an ELClientMqttValue and an ELClientMqttBatch
+#define MQTT_VALUE_PENDING 0x01 /**< The value was not sent yet */
+#define MQTT_VALUE_TOPIC_P 0x02 /**< The topic is in program memory */
+#define MQTT_VALUE_RETAIN  0x04 /**< Publish with the retain flag */
+#define MQTT_VALUE_QOS     3    /**< Shift of the 2-bit qos */
+#define MQTT_BATCH_LENGTH  0x20 /**< Batch in ELC_BATCH_LENGTH format */
+
+/*! startService(void)
+@brief Have ELClient::Process call service()
+@note Internal library function
+*/
+void ELClientMqtt::startService(void) {
+  serviceCb.attach(this, &ELClientMqtt::service);
+  _elc->AddService(&serviceCb);
+}
+
+/*! service(void*)
+@brief Send queued messages and batches whose time window is over, called by ELClient::Process
+@note Internal library function. The ELClient pointer that services get is not needed, this
+	class has its own.
+*/
+void ELClientMqtt::service(void* /*elc*/) {
+  if (_store != NULL && _store->count()) storeSend();
+  if (_queuePending) queueSend();
+  if (_batches == NULL || _elc->SyncState() != ELC_SYNC_DONE) return;
+  uint32_t now = millis();
+  for (ELClientMqttBatch* b = _batches; b != NULL; b = b->next) {
+    if (b->count && b->window && now - b->start >= b->window) flush(b);
+  }
+}
+
+/*! publishTopic(const char* topic, boolean progmem, const uint8_t* data, uint16_t len, uint8_t qos, uint8_t retain)
+@brief Publish to a topic in RAM or flash, by its alias if it is registered
+@note Internal library function
+*/
+void ELClientMqtt::publishTopic(const char* topic, boolean progmem, const uint8_t* data,
+    uint16_t len, uint8_t qos, uint8_t retain)
+{
+#if ELCLIENT_MQTT_TOPICS > 0
+  for (uint8_t id = 0; id < ELCLIENT_MQTT_TOPICS; id++) {
+    if (_topics[id] == topic) {
+      publishId(id, data, len, qos, retain);
+      return;
+    }
+  }
+#endif
+  if (progmem)
+    publish((const __FlashStringHelper*)topic, data, len, qos, retain);
+  else
+    publish(topic, data, len, qos, retain);
 }
 
 // LWT
@@ -68,12 +183,7 @@ void ELClientMqtt::setup(void) {
 @endcode
 */
 void ELClientMqtt::lwt(const char* topic, const char* message, uint8_t qos, uint8_t retain) {
-  _elc->Request(CMD_MQTT_LWT, 0, 4);
-  _elc->Request(topic, strlen(topic));
-  _elc->Request(message, strlen(message));
-  _elc->Request(&qos, 1);
-  _elc->Request(&retain, 1);
-  _elc->Request();
+  _elc->send(CMD_MQTT_LWT, 0, topic, message, qos, retain);
 }
 
 /*! lwt(const __FlashStringHelper* topic, const __FlashStringHelper* message, uint8_t qos, uint8_t retain)
@@ -96,12 +206,7 @@ void ELClientMqtt::lwt(const char* topic, const char* message, uint8_t qos, uint
 void ELClientMqtt::lwt(const __FlashStringHelper* topic, const __FlashStringHelper* message,
     uint8_t qos, uint8_t retain)
 {
-  _elc->Request(CMD_MQTT_LWT, 0, 4);
-  _elc->Request(topic, strlen_P((const char*)topic));
-  _elc->Request(message, strlen_P((const char*)message));
-  _elc->Request(&qos, 1);
-  _elc->Request(&retain, 1);
-  _elc->Request();
+  _elc->send(CMD_MQTT_LWT, 0, topic, message, qos, retain);
 }
 
 // SUBSCRIBE
@@ -121,10 +226,7 @@ void ELClientMqtt::lwt(const __FlashStringHelper* topic, const __FlashStringHelp
 @endcode
 */
 void ELClientMqtt::subscribe(const char* topic, uint8_t qos) {
-  _elc->Request(CMD_MQTT_SUBSCRIBE, 0, 2);
-  _elc->Request(topic, strlen(topic));
-  _elc->Request(&qos, 1);
-  _elc->Request();
+  _elc->send(CMD_MQTT_SUBSCRIBE, 0, topic, qos);
 }
 
 /*! subscribe(const __FlashStringHelper* topic, uint8_t qos)
@@ -141,10 +243,167 @@ void ELClientMqtt::subscribe(const char* topic, uint8_t qos) {
 @endcode
 */
 void ELClientMqtt::subscribe(const __FlashStringHelper* topic, uint8_t qos) {
-  _elc->Request(CMD_MQTT_SUBSCRIBE, 0, 2);
-  _elc->Request(topic, strlen_P((const char*)topic));
-  _elc->Request(&qos, 1);
-  _elc->Request();
+  _elc->send(CMD_MQTT_SUBSCRIBE, 0, topic, qos);
+}
+
+// TOPIC ROUTER
+
+/*! setRoutes(ELClientMqttRoute* nodes, uint8_t count)
+@brief Set up the topic router
+@details The router hands received messages to handlers by topic instead of passing all of them
+	to dataCb. The filters given to on() are kept as a tree with one node per topic level, so a
+	message is matched level by level straight from the receive buffer, without copying the
+	topic into a String, and filters that share their first levels share the nodes. Calling
+	setRoutes again removes all routes.
+@param nodes
+	Nodes of the tree, they must stay valid while the router is used
+@param count
+	Number of nodes, at most 254
+@par Example
+@code
+	ELClientMqttRoute mqttRoutes[8];
+	// in setup()
+	mqtt.setRoutes(mqttRoutes, 8);
+	mqtt.on("sensors/+/temp", onTemperature);
+	mqtt.on("cmd/#", onCommand);
+	mqtt.subscribe("sensors/+/temp");
+	mqtt.subscribe("cmd/#");
+@endcode
+*/
+void ELClientMqtt::setRoutes(ELClientMqttRoute* nodes, uint8_t count) {
+  _routes = nodes;
+  _routeSize = nodes != NULL && count < ELC_ROUTE_NONE ? count : 0;
+  _routeUsed = 0;
+  _routeFirst = ELC_ROUTE_NONE;
+}
+
+/*! on(const char* filter, ELClientMqttHandler handler)
+@brief Add a handler for the messages of a topic filter
+@details + matches exactly one topic level and # the remaining levels, including none
+	("a/#" matches "a"); wildcards only match topics that start with $ below the top level.
+	A message goes to every handler whose filter matches, dataCb only gets the messages that
+	match no filter. Adding a filter again replaces its handler.
+@param filter
+	Topic filter, it is not copied
+@param handler
+	Function called with the topic and the data of the message
+@return <code>boolean</code>
+	False if the filter is invalid (+ or # not a whole level, # not the last level) or the nodes
+	set with setRoutes ran out
+@par Example
+@code
+	void onTemperature(const char* topic, uint16_t topicLen, const uint8_t* data, uint16_t len) {
+		char buf[8];
+		if (len >= sizeof(buf)) return;
+		memcpy(buf, data, len);
+		buf[len] = 0;
+		setHeater(atof(buf) < 19.5);
+	}
+	mqtt.on("sensors/+/temp", onTemperature);
+@endcode
+*/
+boolean ELClientMqtt::on(const char* filter, ELClientMqttHandler handler) {
+  uint8_t* list = &_routeFirst;
+  uint8_t node = ELC_ROUTE_NONE;
+  const char* level = filter;
+  for (;;) {
+    const char* end = strchr(level, '/');
+    uint8_t len = end != NULL ? end - level : strlen(level);
+    if ((memchr(level, '+', len) != NULL && len != 1) ||
+        (memchr(level, '#', len) != NULL && (len != 1 || end != NULL)))
+      return false;
+
+    for (node = *list; node != ELC_ROUTE_NONE; node = _routes[node].next) {
+      if (_routes[node].len == len && memcmp(_routes[node].level, level, len) == 0) break;
+    }
+    if (node == ELC_ROUTE_NONE) {
+      if (_routeUsed == _routeSize) return false;
+      node = _routeUsed++;
+      ELClientMqttRoute* r = &_routes[node];
+      r->level = level;
+      r->len = len;
+      r->child = ELC_ROUTE_NONE;
+      r->next = *list;
+      r->handler = NULL;
+      *list = node;
+    }
+    if (end == NULL) break;
+    list = &_routes[node].child;
+    level = end + 1;
+  }
+  _routes[node].handler = handler;
+  return true;
+}
+
+/*! dataCallback(void* res)
+@brief Called by esp-link with a received message, runs the topic router
+@note Internal library function
+@param res
+	Pointer to ELClientResponse structure, passed on to dataCb if no route matches
+*/
+void ELClientMqtt::dataCallback(void* res) {
+  if (_routeFirst != ELC_ROUTE_NONE) {
+    ELClientResponse* resp = (ELClientResponse*)res;
+    char* topic;
+    uint8_t* data;
+    int16_t topicLen = resp->popArgPtr((void**)&topic);
+    int16_t len = resp->popArgPtr((void**)&data);
+    if (topicLen >= 0 && len >= 0 && routeMatch(_routeFirst, topic, topic, topicLen, data, len))
+      return;
+    // let dataCb pop the arguments from the start
+    ELClientResponse fresh(resp->packet());
+    if (dataCb.attached()) dataCb(&fresh);
+    return;
+  }
+  if (dataCb.attached()) dataCb(res);
+}
+
+/*! routeMatch(uint8_t node, const char* level, const char* topic, uint16_t topicLen, const uint8_t* data, uint16_t len)
+@brief Call the handlers of the nodes in a list that match the topic from level on
+@details Follows every matching node to the next level, so the time depends on the number of
+	levels and the nodes per level, not on the number of filters.
+@note Internal library function
+@return <code>uint8_t</code>
+	Number of handlers called
+*/
+uint8_t ELClientMqtt::routeMatch(uint8_t node, const char* level, const char* topic,
+    uint16_t topicLen, const uint8_t* data, uint16_t len)
+{
+  const char* end = topic + topicLen;
+  const char* levelEnd = (const char*)memchr(level, '/', end - level);
+  if (levelEnd == NULL) levelEnd = end;
+  boolean wild = level != topic || *topic != '$';
+  uint8_t called = 0;
+
+  for (; node != ELC_ROUTE_NONE; node = _routes[node].next) {
+    ELClientMqttRoute* r = &_routes[node];
+    boolean hash = r->len == 1 && r->level[0] == '#';
+    if (hash || (r->len == 1 && r->level[0] == '+')) {
+      if (!wild) continue;
+    } else if (r->len != levelEnd - level || memcmp(r->level, level, r->len) != 0) {
+      continue;
+    }
+
+    if (!hash && levelEnd != end) {
+      called += routeMatch(r->child, levelEnd + 1, topic, topicLen, data, len);
+      continue;
+    }
+    if (!hash) {
+      // last level of the topic, a # below matches this level too
+      for (uint8_t c = r->child; c != ELC_ROUTE_NONE; c = _routes[c].next) {
+        ELClientMqttRoute* h = &_routes[c];
+        if (h->len == 1 && h->level[0] == '#' && h->handler != NULL) {
+          h->handler(topic, topicLen, data, len);
+          called++;
+        }
+      }
+    }
+    if (r->handler != NULL) {
+      r->handler(topic, topicLen, data, len);
+      called++;
+    }
+  }
+  return called;
 }
 
 // PUBLISH
@@ -175,13 +434,8 @@ void ELClientMqtt::subscribe(const __FlashStringHelper* topic, uint8_t qos) {
 void ELClientMqtt::publish(const char* topic, const uint8_t* data, const uint16_t len,
     uint8_t qos, uint8_t retain)
 {
-  _elc->Request(CMD_MQTT_PUBLISH, 0, 5);
-  _elc->Request(topic, strlen(topic));
-  _elc->Request(data, len);
-  _elc->Request(&len, 2);
-  _elc->Request(&qos, 1);
-  _elc->Request(&retain, 1);
-  _elc->Request();
+  if (_store != NULL && hold(topic, false, data, false, len, qos, retain)) return;
+  _elc->send(CMD_MQTT_PUBLISH, 0, topic, ELClient::span(data, len), len, qos, retain);
 }
 
 /*! publish(const char* topic, const char* data, uint8_t qos, uint8_t retain)
@@ -232,13 +486,8 @@ void ELClientMqtt::publish(const char* topic, const char* data, uint8_t qos, uin
 void ELClientMqtt::publish(const __FlashStringHelper* topic, const __FlashStringHelper* data,
     const uint16_t len, uint8_t qos, uint8_t retain)
 {
-  _elc->Request(CMD_MQTT_PUBLISH, 0, 5);
-  _elc->Request(topic, strlen_P((const char*)topic));
-  _elc->Request(data, len);
-  _elc->Request(&len, 2);
-  _elc->Request(&qos, 1);
-  _elc->Request(&retain, 1);
-  _elc->Request();
+  if (_store != NULL && hold((const char*)topic, true, (const uint8_t*)data, true, len, qos, retain)) return;
+  _elc->send(CMD_MQTT_PUBLISH, 0, topic, ELClient::span(data, len), len, qos, retain);
 }
 
 /*! ELClientMqtt::publish(const char* topic, const __FlashStringHelper* data, const uint16_t len, uint8_t qos, uint8_t retain)
@@ -263,13 +512,8 @@ void ELClientMqtt::publish(const __FlashStringHelper* topic, const __FlashString
 void ELClientMqtt::publish(const char* topic, const __FlashStringHelper* data,
     const uint16_t len, uint8_t qos, uint8_t retain)
 {
-  _elc->Request(CMD_MQTT_PUBLISH, 0, 5);
-  _elc->Request(topic, strlen(topic));
-  _elc->Request(data, len);
-  _elc->Request(&len, 2);
-  _elc->Request(&qos, 1);
-  _elc->Request(&retain, 1);
-  _elc->Request();
+  if (_store != NULL && hold(topic, false, (const uint8_t*)data, true, len, qos, retain)) return;
+  _elc->send(CMD_MQTT_PUBLISH, 0, topic, ELClient::span(data, len), len, qos, retain);
 }
 
 /*! publish(const __FlashStringHelper* topic, const uint8_t* data, const uint16_t len, uint8_t qos, uint8_t retain)
@@ -294,11 +538,577 @@ void ELClientMqtt::publish(const char* topic, const __FlashStringHelper* data,
 void ELClientMqtt::publish(const __FlashStringHelper* topic, const uint8_t* data,
     const uint16_t len, uint8_t qos, uint8_t retain)
 {
-  _elc->Request(CMD_MQTT_PUBLISH, 0, 5);
-  _elc->Request(topic, strlen_P((const char*)topic));
-  _elc->Request(data, len);
-  _elc->Request(&len, 2);
-  _elc->Request(&qos, 1);
-  _elc->Request(&retain, 1);
-  _elc->Request();
+  if (_store != NULL && hold((const char*)topic, true, data, false, len, qos, retain)) return;
+  _elc->send(CMD_MQTT_PUBLISH, 0, topic, ELClient::span(data, len), len, qos, retain);
+}
+
+// LATEST-VALUE QUEUE
+
+/*! setQueue(ELClientMqttValue* entries, uint8_t count, uint16_t intervalMs)
+@brief Set up the latest-value publish queue
+@details The queue keeps one value per topic. queue() stores a value and returns right away,
+	Process() publishes the pending values in turn, at most one every intervalMs. A topic that
+	gets a new value before its old one was sent keeps only the new one, so the broker always
+	gets the freshest value and a fast producer never waits for the serial port. Nothing is sent
+	while ELClient is not synced with esp-link. Calling setQueue again drops all queued values.
+@param entries
+	Queue entries, one per topic in use; they must stay valid while the queue is used
+@param count
+	Number of entries
+@param intervalMs
+	Minimum time in milliseconds between two queued publishes, 0 sends all pending values in one
+	Process() call
+@par Example
+@code
+	ELClientMqttValue mqttValues[4];
+	// in setup(): at most 50 publishes per second
+	mqtt.setQueue(mqttValues, 4, 20);
+	// in loop(), as often as new readings come in
+	mqtt.queue("/sensors/temperature", (uint8_t*)&temp, sizeof(temp));
+	esp.Process();
+@endcode
+*/
+void ELClientMqtt::setQueue(ELClientMqttValue* entries, uint8_t count, uint16_t intervalMs) {
+  _queue = entries;
+  _queueSize = entries != NULL ? count : 0;
+  _queuePending = 0;
+  _queueNext = 0;
+  _queueInterval = intervalMs;
+  if (_queueSize) memset(_queue, 0, _queueSize * sizeof(ELClientMqttValue));
+  startService();
+}
+
+/*! queue(const char* topic, const uint8_t* data, uint8_t len, uint8_t qos, uint8_t retain)
+@brief Queue the newest value of a topic for publishing
+@details Replaces the value of the same topic if it was not sent yet. The topic is not copied and
+	must stay valid until the value is sent. Topics registered with registerTopic are published by
+	their alias.
+@param topic
+	Topic name
+@param data
+	Pointer to the value
+@param len
+	Length of the value, at most ELCLIENT_MQTT_VALUE_SIZE
+@param qos
+	(optional) Requested qos level, default 0
+@param retain
+	(optional) Requested retain level, default 0
+@return <code>boolean</code>
+	False if the value is too long or all entries hold other topics
+@par Example
+@code
+	mqtt.queue("/sensors/temperature", (uint8_t*)&temp, sizeof(temp));
+@endcode
+*/
+boolean ELClientMqtt::queue(const char* topic, const uint8_t* data, uint8_t len,
+    uint8_t qos, uint8_t retain)
+{
+  return queueAdd(topic, false, data, len, qos, retain);
+}
+
+/*! queue(const char* topic, const char* data, uint8_t qos, uint8_t retain)
+@brief Queue the newest value of a topic for publishing
+@details Data must be null-terminated, see queue(const char* topic, const uint8_t* data, uint8_t len, uint8_t qos, uint8_t retain)
+@param topic
+	Topic name
+@param data
+	Value
+@param qos
+	(optional) Requested qos level, default 0
+@param retain
+	(optional) Requested retain level, default 0
+@return <code>boolean</code>
+	False if the value is too long or all entries hold other topics
+@par Example
+@code
+	char buf[12];
+	itoa(analogRead(A0), buf, 10);
+	mqtt.queue("/sensors/a0", buf);
+@endcode
+*/
+boolean ELClientMqtt::queue(const char* topic, const char* data, uint8_t qos, uint8_t retain)
+{
+  size_t len = strlen(data);
+  if (len > ELCLIENT_MQTT_VALUE_SIZE) return false;
+  return queueAdd(topic, false, (const uint8_t*)data, len, qos, retain);
+}
+
+/*! queue(const __FlashStringHelper* topic, const uint8_t* data, uint8_t len, uint8_t qos, uint8_t retain)
+@brief Queue the newest value of a topic stored in program memory for publishing
+@details See queue(const char* topic, const uint8_t* data, uint8_t len, uint8_t qos, uint8_t retain)
+@param topic
+	Topic name
+@param data
+	Pointer to the value
+@param len
+	Length of the value, at most ELCLIENT_MQTT_VALUE_SIZE
+@param qos
+	(optional) Requested qos level, default 0
+@param retain
+	(optional) Requested retain level, default 0
+@return <code>boolean</code>
+	False if the value is too long or all entries hold other topics
+@par Example
+@code
+	mqtt.queue(F("/sensors/temperature"), (uint8_t*)&temp, sizeof(temp));
+@endcode
+*/
+boolean ELClientMqtt::queue(const __FlashStringHelper* topic, const uint8_t* data, uint8_t len,
+    uint8_t qos, uint8_t retain)
+{
+  return queueAdd((const char*)topic, true, data, len, qos, retain);
+}
+
+/*! queueAdd(const char* topic, boolean progmem, const uint8_t* data, uint8_t len, uint8_t qos, uint8_t retain)
+@brief Store a value in the entry of its topic, or in a free entry
+@details Topics in RAM are compared by content, topics in flash by address
+@note Internal library function
+@return <code>boolean</code>
+	False if the value is too long or no entry is free
+*/
+boolean ELClientMqtt::queueAdd(const char* topic, boolean progmem, const uint8_t* data,
+    uint8_t len, uint8_t qos, uint8_t retain)
+{
+  if (len > ELCLIENT_MQTT_VALUE_SIZE) return false;
+  ELClientMqttValue* entry = NULL;
+  for (uint8_t i = 0; i < _queueSize; i++) {
+    ELClientMqttValue* e = &_queue[i];
+    if (e->topic == NULL) {
+      if (entry == NULL) entry = e;
+      continue;
+    }
+    boolean eP = (e->flags & MQTT_VALUE_TOPIC_P) != 0;
+    boolean same = e->topic == topic;
+    if (!same && !progmem && !eP) same = strcmp(e->topic, topic) == 0;
+    else if (!same && progmem != eP) same = strcmp_P(progmem ? e->topic : topic, progmem ? topic : e->topic) == 0;
+    if (same) {
+      entry = e;
+      break;
+    }
+  }
+  if (entry == NULL) return false;
+
+  if (entry->topic == NULL || !(entry->flags & MQTT_VALUE_PENDING)) _queuePending++;
+  entry->topic = topic;
+  entry->flags = MQTT_VALUE_PENDING | (progmem ? MQTT_VALUE_TOPIC_P : 0) |
+      (retain ? MQTT_VALUE_RETAIN : 0) | ((qos & 3) << MQTT_VALUE_QOS);
+  entry->len = len;
+  memcpy(entry->data, data, len);
+  return true;
+}
+
+/*! queueSend(void)
+@brief Publish pending values of the latest-value queue
+@details Sends the next pending value after the one sent last, or all of them if no interval is
+	set. The entry stays assigned to its topic, so the topic keeps its place in the queue.
+@note Internal library function
+*/
+void ELClientMqtt::queueSend(void) {
+  if (_elc->SyncState() != ELC_SYNC_DONE) return;
+  uint32_t now = millis();
+  if (_queueInterval && now - _queueSent < _queueInterval) return;
+
+  for (uint8_t n = 0; n < _queueSize && _queuePending; n++) {
+    uint8_t i = _queueNext;
+    if (++_queueNext == _queueSize) _queueNext = 0;
+    ELClientMqttValue* e = &_queue[i];
+    if (!(e->flags & MQTT_VALUE_PENDING)) continue;
+
+    e->flags &= ~MQTT_VALUE_PENDING;
+    _queuePending--;
+    publishTopic(e->topic, (e->flags & MQTT_VALUE_TOPIC_P) != 0, e->data, e->len,
+        (e->flags >> MQTT_VALUE_QOS) & 3, (e->flags & MQTT_VALUE_RETAIN) != 0);
+    _queueSent = now;
+    if (_queueInterval) return;
+  }
+}
+
+// BATCHES
+
+/*! setBatch(ELClientMqttBatch* batch, const char* topic, uint8_t* buf, uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos)
+@brief Set up a batch of messages to one topic
+@details A batch collects messages that are produced at a high rate, e.g. 100Hz telemetry, and
+	publishes them together as one message. That costs one request with one header, CRC and topic
+	instead of one per message, and one delivery on the broker. The batch is sent when the next
+	message would not fit in the buffer or, from Process(), when its first message waited
+	windowMs. Nothing is sent while esp-link is not synced (before Sync() or during a resync),
+	the messages stay in the buffer until then. Calling setBatch on a batch that is in use drops
+	its messages.
+@param batch
+	Batch to set up, it must stay valid while the ELClientMqtt is used
+@param topic
+	Topic the batch is published to; it is not copied
+@param buf
+	Buffer for the payload
+@param size
+	Size of buf
+@param windowMs
+	Longest time in milliseconds a message waits for others, 0 sends only when buf is full
+@param format
+	(optional) ELC_BATCH_LINES to separate the messages by a newline (default), ELC_BATCH_LENGTH to
+	precede each message by its length in 2 bytes, little-endian
+@param qos
+	(optional) Requested qos level, default 0
+@par Example
+@code
+	ELClientMqttBatch accelBatch;
+	uint8_t accelBuf[96];
+	// in setup(): send at least every 200ms
+	mqtt.setBatch(&accelBatch, "/sensors/accel", accelBuf, sizeof(accelBuf), 200);
+	// in loop(), every 10ms
+	char line[16];
+	itoa(analogRead(A0), line, 10);
+	mqtt.batch(&accelBatch, line);
+	esp.Process();
+@endcode
+*/
+void ELClientMqtt::setBatch(ELClientMqttBatch* batch, const char* topic, uint8_t* buf,
+    uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos)
+{
+  batchSetup(batch, topic, false, buf, size, windowMs, format, qos);
+}
+
+/*! setBatch(ELClientMqttBatch* batch, const __FlashStringHelper* topic, uint8_t* buf, uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos)
+@brief Set up a batch of messages to a topic stored in program memory
+@details See setBatch(ELClientMqttBatch* batch, const char* topic, uint8_t* buf, uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos)
+@par Example
+@code
+	mqtt.setBatch(&accelBatch, F("/sensors/accel"), accelBuf, sizeof(accelBuf), 200, ELC_BATCH_LENGTH);
+@endcode
+*/
+void ELClientMqtt::setBatch(ELClientMqttBatch* batch, const __FlashStringHelper* topic,
+    uint8_t* buf, uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos)
+{
+  batchSetup(batch, (const char*)topic, true, buf, size, windowMs, format, qos);
+}
+
+/*! batchSetup(ELClientMqttBatch* batch, const char* topic, boolean progmem, uint8_t* buf, uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos)
+@brief Initialize a batch and add it to the list that service() checks
+@note Internal library function
+*/
+void ELClientMqtt::batchSetup(ELClientMqttBatch* batch, const char* topic, boolean progmem,
+    uint8_t* buf, uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos)
+{
+  ELClientMqttBatch* b = _batches;
+  while (b != NULL && b != batch) b = b->next;
+  if (b == NULL) {
+    batch->next = _batches;
+    _batches = batch;
+  }
+  batch->topic = topic;
+  batch->buf = buf;
+  batch->size = size;
+  batch->len = 0;
+  batch->window = windowMs;
+  batch->count = 0;
+  batch->start = 0;
+  batch->dropped = 0;
+  batch->flags = (progmem ? MQTT_VALUE_TOPIC_P : 0) | ((qos & 3) << MQTT_VALUE_QOS) |
+      (format == ELC_BATCH_LENGTH ? MQTT_BATCH_LENGTH : 0);
+  startService();
+}
+
+/*! batch(ELClientMqttBatch* batch, const uint8_t* data, uint16_t len)
+@brief Add a message to a batch
+@details Publishes the batch first if the message does not fit any more. If esp-link is not
+	synced the batch is kept instead and the message is dropped and counted in batch->dropped.
+@param batch
+	Batch set up with setBatch
+@param data
+	Pointer to the message
+@param len
+	Length of the message
+@return <code>boolean</code>
+	False if the message is too long for the buffer of the batch or was dropped
+@par Example
+@code
+	int16_t sample[3] = { x, y, z };
+	mqtt.batch(&accelBatch, (uint8_t*)sample, sizeof(sample));
+@endcode
+*/
+boolean ELClientMqtt::batch(ELClientMqttBatch* batch, const uint8_t* data, uint16_t len) {
+  uint16_t need = len + (batch->flags & MQTT_BATCH_LENGTH ? 2 : 1);
+  if (need > batch->size) return false;
+  if (batch->len + need > batch->size) {
+    flush(batch);
+    if (batch->len != 0) {
+      batch->dropped++;
+      return false;
+    }
+  }
+
+  uint8_t* p = batch->buf + batch->len;
+  if (batch->flags & MQTT_BATCH_LENGTH) {
+    *p++ = len & 0xFF;
+    *p++ = len >> 8;
+  }
+  memcpy(p, data, len);
+  if (!(batch->flags & MQTT_BATCH_LENGTH)) p[len] = '\n';
+  if (batch->count++ == 0) batch->start = millis();
+  batch->len += need;
+  return true;
+}
+
+/*! batch(ELClientMqttBatch* batch, const char* data)
+@brief Add a null-terminated message to a batch
+@details See batch(ELClientMqttBatch* batch, const uint8_t* data, uint16_t len)
+@param batch
+	Batch set up with setBatch
+@param data
+	Message
+@return <code>boolean</code>
+	False if the message is too long for the buffer of the batch or was dropped
+@par Example
+@code
+	mqtt.batch(&accelBatch, "12,-3,980");
+@endcode
+*/
+boolean ELClientMqtt::batch(ELClientMqttBatch* batch, const char* data) {
+  return ELClientMqtt::batch(batch, (const uint8_t*)data, strlen(data));
+}
+
+/*! flush(ELClientMqttBatch* batch)
+@brief Publish the messages collected in a batch
+@details Does nothing if the batch is empty or esp-link is not synced, the messages are kept
+	then. In ELC_BATCH_LINES format the last newline is not sent.
+@param batch
+	Batch set up with setBatch
+@par Example
+@code
+	mqtt.flush(&accelBatch);
+@endcode
+*/
+void ELClientMqtt::flush(ELClientMqttBatch* batch) {
+  if (batch->count == 0 || _elc->SyncState() != ELC_SYNC_DONE) return;
+  uint16_t len = batch->flags & MQTT_BATCH_LENGTH ? batch->len : batch->len - 1;
+  publishTopic(batch->topic, (batch->flags & MQTT_VALUE_TOPIC_P) != 0, batch->buf, len,
+      (batch->flags >> MQTT_VALUE_QOS) & 3, 0);
+  batch->len = 0;
+  batch->count = 0;
+}
+
+// STORE-AND-FORWARD
+
+/*! setStore(ELClientMqttStore* store, uint16_t intervalMs)
+@brief Keep publishes while the broker is not connected
+@details esp-link drops publishes while it has no connection to the broker. With a store set,
+	publish() and publishId() put the message into the store instead whenever connected() is
+	false, and Process() replays the stored messages in order once esp-link reports the
+	connection again, at most one every intervalMs so the broker and the serial port are not
+	flooded after an outage. Messages published during the replay queue up behind the stored
+	ones. Messages too long for a slot of the store are dropped and counted in the dropped() of
+	the store, like the oldest message that is dropped when the store is full.
+	The store finds the messages left in its storage (e.g. EEPROM, from before a reset) first.
+	Publishes before the first connected callback after setup() are stored, too.
+@param store
+	Store for the messages, NULL to stop storing
+@param intervalMs
+	Minimum time in milliseconds between two replayed publishes, 0 replays all in one Process()
+@par Example
+@code
+	#include <EEPROM.h>
+	ELClientEepromStorage<EEPROMClass> mqttStorage(EEPROM, 0, 1024);
+	ELClientMqttStore mqttStore(&mqttStorage);
+	// in setup(), after mqtt.setup(): replay 20 messages per second
+	EEPROM.begin(1024); // ESP8266 and ESP32 only
+	mqtt.setStore(&mqttStore, 50);
+@endcode
+*/
+void ELClientMqtt::setStore(ELClientMqttStore* store, uint16_t intervalMs) {
+  _store = store;
+  _storeInterval = intervalMs;
+  if (_store == NULL) return;
+  _store->begin();
+  startService();
+}
+
+/*! hold(const char* topic, boolean topicP, const uint8_t* data, boolean dataP, uint16_t len, uint8_t qos, uint8_t retain)
+@brief Put a publish into the store if it cannot be sent now
+@note Internal library function
+@return <code>boolean</code>
+	True if the message was stored or dropped by the store, false if it is to be sent
+*/
+boolean ELClientMqtt::hold(const char* topic, boolean topicP, const uint8_t* data, boolean dataP,
+    uint16_t len, uint8_t qos, uint8_t retain)
+{
+  if (_store->count() == 0 && connected()) return false;
+  // a message the store refuses is dropped: sent now it would overtake the stored ones or be lost
+  _store->push(topic, topicP, data, dataP, len, qos, retain);
+  return true;
+}
+
+/*! storeSend(void)
+@brief Replay stored publishes while the broker is connected
+@note Internal library function
+*/
+void ELClientMqtt::storeSend(void) {
+  if (!connected()) return;
+  uint32_t now = millis();
+  if (_storeInterval && now - _storeSent < _storeInterval) return;
+
+  char topic[ELCLIENT_MQTT_STORE_SLOT];
+  uint8_t data[ELCLIENT_MQTT_STORE_SLOT];
+  uint8_t len, qos, retain;
+  while (_store->front(topic, data, &len, &qos, &retain)) {
+    uint16_t len16 = len;
+    _elc->send(CMD_MQTT_PUBLISH, 0, topic, ELClient::span(data, len16), len16, qos, retain);
+    _store->pop();
+    _storeSent = now;
+    if (_storeInterval) return;
+  }
+}
+
+#if ELCLIENT_MQTT_TOPICS > 0
+// TOPIC ALIASES
+
+/*! registerTopic(const char* topic)
+@brief Register a topic for publishId
+@details esp-link keeps the topic under a small id, publishId then sends only the id instead of
+	the topic string, which usually is most of a publish request. The topic is not copied, it
+	must stay valid as it is sent again when esp-link synced in the meantime (e.g. after a reset
+	of esp-link). Registering the same topic again returns the same id.
+@warning Needs an esp-link that supports CMD_MQTT_TOPIC and CMD_MQTT_PUBLISH_ID.
+@param topic
+	Topic name
+@return <code>int8_t</code>
+	Id of the topic, -1 if ELCLIENT_MQTT_TOPICS topics are already registered
+@par Example
+@code
+	int8_t tempTopic = mqtt.registerTopic("/sensors/livingroom/temperature");
+	// ... in loop()
+	mqtt.publishId(tempTopic, buf);
+@endcode
+*/
+int8_t ELClientMqtt::registerTopic(const char* topic) {
+  return topicAdd(topic, false);
+}
+
+/*! registerTopic(const __FlashStringHelper* topic)
+@brief Register a topic stored in program memory for publishId
+@details See registerTopic(const char* topic)
+@param topic
+	Topic name
+@return <code>int8_t</code>
+	Id of the topic, -1 if ELCLIENT_MQTT_TOPICS topics are already registered
+@par Example
+@code
+	int8_t tempTopic = mqtt.registerTopic(F("/sensors/livingroom/temperature"));
+@endcode
+*/
+int8_t ELClientMqtt::registerTopic(const __FlashStringHelper* topic) {
+  return topicAdd((const char*)topic, true);
+}
+
+/*! topicAdd(const char* topic, boolean progmem)
+@brief Enter a topic in the alias table and register it with esp-link
+@note Internal library function
+@param topic
+	Topic name
+@param progmem
+	True if the topic is stored in program memory
+@return <code>int8_t</code>
+	Id of the topic, -1 if the table is full
+*/
+int8_t ELClientMqtt::topicAdd(const char* topic, boolean progmem) {
+  int8_t slot = -1;
+  for (uint8_t id = 0; id < ELCLIENT_MQTT_TOPICS; id++) {
+    if (_topics[id] == topic) return id;
+    if (_topics[id] == NULL && slot < 0) slot = id;
+  }
+  if (slot < 0) return -1;
+
+  _topics[slot] = topic;
+  if (progmem) _topicsP |= 1 << slot;
+  else _topicsP &= ~(1 << slot);
+
+  // if esp-link synced since the others were registered they are all sent again, this one with
+  // them; before the first sync nothing is sent
+  if (_topicEpoch != _elc->SyncEpoch()) topicsCheck();
+  else if (_topicEpoch != 0) topicSend(slot);
+  return slot;
+}
+
+/*! topicSend(uint8_t id)
+@brief Send one topic alias to esp-link
+@note Internal library function
+@param id
+	Id of the topic
+*/
+void ELClientMqtt::topicSend(uint8_t id) {
+  if (_topicsP & (1 << id))
+    _elc->send(CMD_MQTT_TOPIC, id, (const __FlashStringHelper*)_topics[id]);
+  else
+    _elc->send(CMD_MQTT_TOPIC, id, _topics[id]);
+}
+
+/*! topicsCheck(void)
+@brief Register all topics again if esp-link synced since they were registered
+@details esp-link forgets the topics when it syncs, ELClient::SyncEpoch() tells whether that
+	happened. Nothing is sent before the first sync, the topics go out with the first publishId
+	after it.
+@note Internal library function
+*/
+void ELClientMqtt::topicsCheck(void) {
+  uint8_t epoch = _elc->SyncEpoch();
+  if (epoch == _topicEpoch || epoch == 0) return;
+  _topicEpoch = epoch;
+  for (uint8_t id = 0; id < ELCLIENT_MQTT_TOPICS; id++)
+    if (_topics[id] != NULL) topicSend(id);
+}
+
+/*! publishId(uint8_t id, const uint8_t* data, const uint16_t len, uint8_t qos, uint8_t retain)
+@brief Publish MQTT message to a registered topic
+@details The request carries only the data, the id, qos and retain flag are packed into its value:
+	bits 0-7 id, bits 8-9 qos, bit 10 retain.
+@param id
+	Id returned by registerTopic
+@param data
+	Pointer to data buffer
+@param len
+	Size of data buffer
+@param qos
+	(optional) Requested qos level, default 0
+@param retain
+	(optional) Requested retain level, default 0
+@par Example
+@code
+	int8_t tempTopic = mqtt.registerTopic("/sensors/livingroom/temperature");
+	// ... in loop()
+	float temp = readTemperature();
+	mqtt.publishId(tempTopic, (uint8_t*)&temp, sizeof(temp));
+@endcode
+*/
+void ELClientMqtt::publishId(uint8_t id, const uint8_t* data, const uint16_t len,
+    uint8_t qos, uint8_t retain)
+{
+  if (id >= ELCLIENT_MQTT_TOPICS || _topics[id] == NULL) return;
+  if (_store != NULL && hold(_topics[id], (_topicsP >> id) & 1, data, false, len, qos, retain))
+    return;
+  topicsCheck();
+  uint32_t value = id | ((uint32_t)(qos & 3) << 8) | ((uint32_t)(retain ? 1 : 0) << 10);
+  _elc->send(CMD_MQTT_PUBLISH_ID, value, ELClient::span(data, len));
+}
+
+/*! publishId(uint8_t id, const char* data, uint8_t qos, uint8_t retain)
+@brief Publish MQTT message to a registered topic
+@details Data must be null-terminated
+@param id
+	Id returned by registerTopic
+@param data
+	Pointer to data buffer
+@param qos
+	(optional) Requested qos level, default 0
+@param retain
+	(optional) Requested retain level, default 0
+@par Example
+@code
+	char buf[12];
+	itoa(count++, buf, 10);
+	mqtt.publishId(counterTopic, buf);
+@endcode
+*/
+void ELClientMqtt::publishId(uint8_t id, const char* data, uint8_t qos, uint8_t retain)
+{
+  publishId(id, (const uint8_t*)data, strlen(data), qos, retain);
 }
+#endif
@@ -12,6 +12,62 @@
 #include <stdint.h>
 #include "FP.h"
 #include "ELClient.h"
+#include "ELClientMqttStore.h"
+
+#ifndef ELCLIENT_MQTT_TOPICS
+#define ELCLIENT_MQTT_TOPICS 4 /**< Number of topics that can be registered for publishId (max 8), 0 compiles topic aliases out */
+#endif
+
+#ifndef ELCLIENT_MQTT_VALUE_SIZE
+#define ELCLIENT_MQTT_VALUE_SIZE 16 /**< Largest value (max 255 bytes) that ELClientMqtt::queue accepts */
+#endif
+
+// Entry of the latest-value publish queue, the entries are provided by the sketch with
+// ELClientMqtt::setQueue
+typedef struct {
+  const char* topic;  /**< Topic, NULL if the entry is free */
+  uint8_t flags;      /**< Pending, topic in flash, qos and retain, see ELClientMqtt.cpp */
+  uint8_t len;        /**< Length of the value */
+  uint8_t data[ELCLIENT_MQTT_VALUE_SIZE]; /**< Newest value of the topic */
+} ELClientMqttValue;
+
+// Formats of an ELClientMqttBatch payload
+typedef enum {
+  ELC_BATCH_LINES = 0, /**< Messages separated by a newline, for text */
+  ELC_BATCH_LENGTH     /**< Each message preceded by its length as 2 bytes little-endian, for binary data */
+} ELClientBatchFormat;
+
+// Batch of messages to one topic, set up with ELClientMqtt::setBatch. The buffer is provided by
+// the sketch, the fields are managed by ELClientMqtt.
+typedef struct ELClientMqttBatch {
+  const char* topic;  /**< Topic the batch is published to */
+  uint8_t* buf;       /**< Payload being collected */
+  uint16_t size;      /**< Size of buf, the batch is sent before it overflows */
+  uint16_t len;       /**< Bytes in buf */
+  uint16_t window;    /**< Time in milliseconds a message may wait for more to join it, 0 = until buf is full */
+  uint16_t count;     /**< Messages in buf */
+  uint32_t start;     /**< millis() when the first message in buf was added */
+  uint8_t flags;      /**< Format, topic in flash and qos, see ELClientMqtt.cpp */
+  uint16_t dropped;   /**< Messages dropped because buf was full while esp-link was not synced */
+  struct ELClientMqttBatch* next; /**< Next batch of the same ELClientMqtt */
+} ELClientMqttBatch;
+
+// Handler of a topic route, topic and data point into the receive buffer and are not
+// null-terminated
+typedef void (*ELClientMqttHandler)(const char* topic, uint16_t topicLen, const uint8_t* data,
+    uint16_t len);
+
+#define ELC_ROUTE_NONE 0xFF /**< No node, ends a list of ELClientMqttRoute nodes */
+
+// Node of the topic router, one per topic level of the filters passed to ELClientMqtt::on. The
+// nodes are provided by the sketch with ELClientMqtt::setRoutes and managed by ELClientMqtt.
+typedef struct {
+  const char* level;  /**< Topic level in the filter, not null-terminated */
+  uint8_t len;        /**< Length of level */
+  uint8_t child;      /**< First node of the next level */
+  uint8_t next;       /**< Next node of the same level */
+  ELClientMqttHandler handler; /**< Handler of the filter that ends here, NULL if none */
+} ELClientMqttRoute;
 
 // Class to send and receive MQTT messages. This class should be used with a singleton object
 // because the esp-link implementation currently only supports a single MQTT server, so there is
@@ -27,8 +83,9 @@ class ELClientMqtt {
     // setup transmits the set of callbacks to esp-link. It assumes that the desired callbacks
     // have previously been attached using something like mqtt->connectedCb.attach(myCallbackFun).
     // After setup is called either the connectedCb or the disconnectedCb is invoked to provide
-    // information about the initial connection status.
-    void setup(void);
+    // information about the initial connection status. Returns false (and sends nothing) if the
+    // callback table of ELClient has no room for the four callbacks, see ELCLIENT_MAX_CALLBACKS.
+    boolean setup(void);
 
     // callbacks that can be attached prior to calling setup
     FP<void, void*> connectedCb;    /**< callback with no args when MQTT is connected */
@@ -41,6 +98,14 @@ class ELClientMqtt {
     void subscribe(const char* topic, uint8_t qos=0);
     void subscribe(const __FlashStringHelper* topic, uint8_t qos=0);
 
+    // topic router: on() adds a handler for a topic filter, + matches one topic level and # the
+    // rest of the topic. Received messages go to the handlers of all matching filters, messages
+    // that match none go to dataCb. The filters are not copied and need one node per level that
+    // is not shared with another filter; on() returns false if the nodes run out or the filter
+    // is invalid. The subscriptions are still made with subscribe().
+    void setRoutes(ELClientMqttRoute* nodes, uint8_t count);
+    boolean on(const char* filter, ELClientMqttHandler handler);
+
     // publish a message to a topic
     void publish(const char* topic, const uint8_t* data,
         const uint16_t len, uint8_t qos=0, uint8_t retain=0);
@@ -53,6 +118,56 @@ class ELClientMqtt {
     void publish(const __FlashStringHelper* topic, const uint8_t* data,
         const uint16_t len, uint8_t qos=0, uint8_t retain=0);
 
+#if ELCLIENT_MQTT_TOPICS > 0
+    // register a topic once so publishId only sends its id instead of the whole topic. The topic
+    // is not copied, it must stay valid. After a sync the topics are registered again before the
+    // next publishId. Returns the id, or -1 if all ELCLIENT_MQTT_TOPICS ids are in use.
+    // Needs an esp-link that supports CMD_MQTT_TOPIC.
+    int8_t registerTopic(const char* topic);
+    int8_t registerTopic(const __FlashStringHelper* topic);
+
+    // publish a message to a topic registered with registerTopic
+    void publishId(uint8_t id, const uint8_t* data, const uint16_t len,
+        uint8_t qos=0, uint8_t retain=0);
+    void publishId(uint8_t id, const char* data, uint8_t qos=0, uint8_t retain=0);
+#endif
+
+    // latest-value queue for values that are produced faster than they can be sent. queue() only
+    // stores the value, replacing a value of the same topic that was not sent yet, and returns
+    // false if no entry is free or the value is longer than ELCLIENT_MQTT_VALUE_SIZE. Process()
+    // publishes the pending values in turn, at most one every intervalMs (0 = all at once).
+    // The topics are not copied, they must stay valid until their value is sent.
+    void setQueue(ELClientMqttValue* entries, uint8_t count, uint16_t intervalMs);
+    boolean queue(const char* topic, const uint8_t* data, uint8_t len,
+        uint8_t qos=0, uint8_t retain=0);
+    boolean queue(const char* topic, const char* data, uint8_t qos=0, uint8_t retain=0);
+    boolean queue(const __FlashStringHelper* topic, const uint8_t* data, uint8_t len,
+        uint8_t qos=0, uint8_t retain=0);
+    // number of queued values that were not sent yet
+    uint8_t queued(void) { return _queuePending; }
+
+    // batches for high-rate streams of messages to one topic. batch() appends a message to the
+    // payload buffer of the batch, which is published as a single message when the next one does
+    // not fit or, from Process(), when the oldest message waited windowMs. Nothing is sent while
+    // esp-link is not synced, a message that does not fit then is dropped and counted in
+    // dropped. Returns false if the message is dropped or can never fit in the buffer.
+    void setBatch(ELClientMqttBatch* batch, const char* topic, uint8_t* buf, uint16_t size,
+        uint16_t windowMs, ELClientBatchFormat format=ELC_BATCH_LINES, uint8_t qos=0);
+    void setBatch(ELClientMqttBatch* batch, const __FlashStringHelper* topic, uint8_t* buf,
+        uint16_t size, uint16_t windowMs, ELClientBatchFormat format=ELC_BATCH_LINES, uint8_t qos=0);
+    boolean batch(ELClientMqttBatch* batch, const uint8_t* data, uint16_t len);
+    boolean batch(ELClientMqttBatch* batch, const char* data);
+    // publish the messages collected so far, if esp-link is synced
+    void flush(ELClientMqttBatch* batch);
+
+    // store-and-forward: once a store is set, publishes are kept in it while the broker is not
+    // connected (before connectedCb, after disconnectedCb or an esp-link resync) and replayed in
+    // order from Process() when it is, at most one every intervalMs (0 = all at once). Until the
+    // store is empty new publishes queue up behind the stored ones.
+    void setStore(ELClientMqttStore* store, uint16_t intervalMs);
+    // true between connectedCb and disconnectedCb, as long as esp-link did not resync
+    boolean connected(void);
+
     // set a last-will topic & message
     void lwt(const char* topic, const char* message, uint8_t qos=0, uint8_t retain=0);
     void lwt(const __FlashStringHelper* topic, const __FlashStringHelper* message,
@@ -60,6 +175,51 @@ class ELClientMqtt {
 
   private:
     ELClient* _elc; /**< ELClient instance */
+    FP<void, void*> serviceCb; /**< Registered with ELClient::AddService, sends queued messages */
+    ELClientMqttValue* _queue; /**< Entries of the latest-value queue */
+    uint8_t _queueSize; /**< Number of entries in _queue */
+    uint8_t _queuePending; /**< Entries with a value that was not sent yet */
+    uint8_t _queueNext; /**< Entry to look at first when sending, so all topics get their turn */
+    uint16_t _queueInterval; /**< Minimum time in milliseconds between two queued publishes */
+    uint32_t _queueSent; /**< millis() of the last queued publish */
+    ELClientMqttBatch* _batches; /**< Batches set up with setBatch */
+    FP<void, void*> connCb; /**< Registered with esp-link, tracks the connection and calls connectedCb */
+    FP<void, void*> discCb; /**< Registered with esp-link, tracks the connection and calls disconnectedCb */
+    FP<void, void*> routeCb; /**< Registered with esp-link, runs the topic router and calls dataCb */
+    ELClientMqttRoute* _routes; /**< Nodes of the topic router */
+    uint8_t _routeSize; /**< Number of nodes */
+    uint8_t _routeUsed; /**< Nodes in use */
+    uint8_t _routeFirst; /**< First node of the top level */
+    void dataCallback(void* res);
+    uint8_t routeMatch(uint8_t node, const char* level, const char* topic, uint16_t topicLen,
+        const uint8_t* data, uint16_t len);
+    boolean _connected; /**< Set by connCb, cleared by discCb */
+    uint8_t _connEpoch; /**< Sync epoch of esp-link when connCb was called */
+    ELClientMqttStore* _store; /**< Store-and-forward queue, NULL if not used */
+    uint16_t _storeInterval; /**< Minimum time in milliseconds between two replayed publishes */
+    uint32_t _storeSent; /**< millis() of the last replayed publish */
+    void connectedCallback(void* res);
+    void disconnectedCallback(void* res);
+    boolean hold(const char* topic, boolean topicP, const uint8_t* data, boolean dataP,
+        uint16_t len, uint8_t qos, uint8_t retain);
+    void storeSend(void);
+    void startService(void);
+    void service(void* elc);
+    void batchSetup(ELClientMqttBatch* batch, const char* topic, boolean progmem, uint8_t* buf,
+        uint16_t size, uint16_t windowMs, ELClientBatchFormat format, uint8_t qos);
+    boolean queueAdd(const char* topic, boolean progmem, const uint8_t* data, uint8_t len,
+        uint8_t qos, uint8_t retain);
+    void queueSend(void);
+    void publishTopic(const char* topic, boolean progmem, const uint8_t* data, uint16_t len,
+        uint8_t qos, uint8_t retain);
+#if ELCLIENT_MQTT_TOPICS > 0
+    const char* _topics[ELCLIENT_MQTT_TOPICS]; /**< Registered topics by id, NULL if the id is free */
+    uint8_t _topicsP; /**< Bit mask of the registered topics that are in program memory */
+    uint8_t _topicEpoch; /**< Sync epoch of esp-link the topics were registered with */
+    int8_t topicAdd(const char* topic, boolean progmem);
+    void topicSend(uint8_t id);
+    void topicsCheck(void);
+#endif
 };
 
 #endif // _EL_CLIENT_MQTT_H_
@@ -0,0 +1,211 @@
+/*! \file ELClientMqttStore.cpp
+    \brief Constructor and functions for ELClientMqttStore
+    \note Store-and-forward queue of ELClientMqtt
+*/
+
+#include "ELClientMqttStore.h"
+
+// Layout of a slot
+#define SLOT_STATE  0 /**< SLOT_QUEUED, SLOT_SENT or anything else for a slot never written */
+#define SLOT_SEQ    1 /**< Sequence number, 2 bytes little-endian */
+#define SLOT_FLAGS  3 /**< qos in bits 0-1, retain in bit 2 */
+#define SLOT_TOPIC  4 /**< Length of the topic */
+#define SLOT_LEN    5 /**< Length of the data */
+#define SLOT_DATA   6 /**< Topic, followed by the data */
+
+// The lengths of topic and data are one byte each, the size check of push relies on the slot
+// being too small for either to reach 256
+static_assert(ELCLIENT_MQTT_STORE_SLOT <= SLOT_DATA + 255, "ELCLIENT_MQTT_STORE_SLOT must be at most 261");
+
+// States of a slot. Sent clears bits of queued, so flash can mark a slot without erasing it.
+#define SLOT_QUEUED 0xA5 /**< The slot holds a message that was not sent yet */
+#define SLOT_SENT   0x21 /**< The message of the slot was sent or dropped */
+
+/*! ELClientMqttStore(ELClientStorage* storage)
+@brief Constructor for ELClientMqttStore
+@details The store uses all of the storage, in slots of ELCLIENT_MQTT_STORE_SLOT bytes.
+	Nothing is read before begin().
+@param storage
+	Storage for the messages, e.g. an ELClientRamStorage or an ELClientEepromStorage (which is
+	flash-backed on ESP8266 and ESP32)
+@par Example
+@code
+	uint8_t mqttStoreBuf[8*ELCLIENT_MQTT_STORE_SLOT];
+	ELClientRamStorage mqttStorage(mqttStoreBuf, sizeof(mqttStoreBuf));
+	ELClientMqttStore mqttStore(&mqttStorage);
+@endcode
+*/
+ELClientMqttStore::ELClientMqttStore(ELClientStorage* storage) :
+  _storage(storage), _slots(0), _head(0), _count(0), _seq(0), _dropped(0) {}
+
+/*! slotState(uint16_t slot)
+@brief Read the state of a slot
+@note Internal library function
+*/
+uint8_t ELClientMqttStore::slotState(uint16_t slot) {
+  return _storage->read(slot * ELCLIENT_MQTT_STORE_SLOT + SLOT_STATE);
+}
+
+/*! slotSeq(uint16_t slot)
+@brief Read the sequence number of a slot
+@note Internal library function
+*/
+uint16_t ELClientMqttStore::slotSeq(uint16_t slot) {
+  uint16_t addr = slot * ELCLIENT_MQTT_STORE_SLOT + SLOT_SEQ;
+  return _storage->read(addr) | _storage->read(addr + 1) << 8;
+}
+
+/*! begin(void)
+@brief Find the messages that are in the storage
+@details The slot written last is the one with the highest sequence number, its successors up to
+	the first queued slot were sent already. A fresh storage (any content) starts out empty.
+@par Example
+@code
+	mqttStore.begin();
+	Serial.print(mqttStore.count());
+	Serial.println(" messages left from before the reset");
+@endcode
+*/
+void ELClientMqttStore::begin(void) {
+  _slots = _storage->length() / ELCLIENT_MQTT_STORE_SLOT;
+  _head = 0;
+  _count = 0;
+  _seq = 0;
+
+  int32_t last = -1;
+  for (uint16_t i = 0; i < _slots; i++) {
+    uint8_t state = slotState(i);
+    if (state != SLOT_QUEUED && state != SLOT_SENT) continue;
+    uint16_t seq = slotSeq(i);
+    if (last < 0 || (int16_t)(seq - _seq) >= 0) {
+      last = i;
+      _seq = seq;
+    }
+  }
+  if (last < 0) return;
+  _seq++;
+
+  // the queued messages are the run of slots that ends with the one written last
+  uint16_t next = (last + 1) % _slots;
+  _head = next;
+  for (uint16_t n = 0; n < _slots; n++) {
+    uint16_t i = (next + n) % _slots;
+    if (slotState(i) == SLOT_QUEUED) {
+      if (_count == 0) _head = i;
+      _count++;
+    } else {
+      _count = 0;
+    }
+  }
+  if (_count == 0) _head = next;
+}
+
+/*! clear(void)
+@brief Drop all messages
+*/
+void ELClientMqttStore::clear(void) {
+  while (_count) pop();
+}
+
+/*! copy(uint16_t addr, const char* src, boolean progmem, uint8_t len)
+@brief Write bytes from RAM or flash to the storage
+@note Internal library function
+*/
+void ELClientMqttStore::copy(uint16_t addr, const char* src, boolean progmem, uint8_t len) {
+  for (uint8_t i = 0; i < len; i++)
+    _storage->write(addr + i, progmem ? pgm_read_byte(src + i) : (uint8_t)src[i]);
+}
+
+/*! push(const char* topic, boolean topicP, const uint8_t* data, boolean dataP, uint16_t len, uint8_t qos, uint8_t retain)
+@brief Add a message
+@details The message goes into the slot after the one written last, if that slot holds the
+	oldest message, it is dropped. The state is written last, so a message that was cut short by
+	a reset is not found by begin().
+@param topic
+	Topic name
+@param topicP
+	True if the topic is in program memory
+@param data
+	Pointer to the data
+@param dataP
+	True if the data is in program memory
+@param len
+	Length of the data
+@param qos
+	Requested qos level
+@param retain
+	Requested retain level
+@return <code>boolean</code>
+	False if topic and data are longer than a slot holds
+*/
+boolean ELClientMqttStore::push(const char* topic, boolean topicP, const uint8_t* data,
+    boolean dataP, uint16_t len, uint8_t qos, uint8_t retain)
+{
+  uint16_t tlen = topicP ? strlen_P(topic) : strlen(topic);
+  if (_slots == 0 || SLOT_DATA + tlen + len > ELCLIENT_MQTT_STORE_SLOT) {
+    _dropped++;
+    return false;
+  }
+  if (_count == _slots) {
+    pop();
+    _dropped++;
+  }
+
+  uint16_t slot = (_head + _count) % _slots;
+  uint16_t addr = slot * ELCLIENT_MQTT_STORE_SLOT;
+  _storage->write(addr + SLOT_FLAGS, (qos & 3) | (retain ? 4 : 0));
+  _storage->write(addr + SLOT_TOPIC, tlen);
+  _storage->write(addr + SLOT_LEN, len);
+  copy(addr + SLOT_DATA, topic, topicP, tlen);
+  copy(addr + SLOT_DATA + tlen, (const char*)data, dataP, len);
+  _storage->write(addr + SLOT_SEQ, _seq & 0xFF);
+  _storage->write(addr + SLOT_SEQ + 1, _seq >> 8);
+  _storage->write(addr + SLOT_STATE, SLOT_QUEUED);
+  _storage->commit();
+  _seq++;
+  _count++;
+  return true;
+}
+
+/*! front(char* topic, uint8_t* data, uint8_t* len, uint8_t* qos, uint8_t* retain)
+@brief Copy the oldest message
+@param topic
+	Buffer for the topic of ELCLIENT_MQTT_STORE_SLOT bytes, gets a terminating null
+@param data
+	Buffer for the data of ELCLIENT_MQTT_STORE_SLOT bytes
+@param len
+	Set to the length of the data
+@param qos
+	Set to the requested qos level
+@param retain
+	Set to the requested retain level
+@return <code>boolean</code>
+	False if the store is empty
+*/
+boolean ELClientMqttStore::front(char* topic, uint8_t* data, uint8_t* len, uint8_t* qos,
+    uint8_t* retain)
+{
+  if (_count == 0) return false;
+  uint16_t addr = _head * ELCLIENT_MQTT_STORE_SLOT;
+  uint8_t flags = _storage->read(addr + SLOT_FLAGS);
+  uint8_t tlen = _storage->read(addr + SLOT_TOPIC);
+  *len = _storage->read(addr + SLOT_LEN);
+  *qos = flags & 3;
+  *retain = (flags >> 2) & 1;
+  for (uint8_t i = 0; i < tlen; i++) topic[i] = _storage->read(addr + SLOT_DATA + i);
+  topic[tlen] = 0;
+  for (uint8_t i = 0; i < *len; i++) data[i] = _storage->read(addr + SLOT_DATA + tlen + i);
+  return true;
+}
+
+/*! pop(void)
+@brief Mark the oldest message as sent
+@details The storage is committed when the last message is popped, or with the next push(), so
+	a replay of many messages does not wear out flash-backed storage.
+*/
+void ELClientMqttStore::pop(void) {
+  if (_count == 0) return;
+  _storage->write(_head * ELCLIENT_MQTT_STORE_SLOT + SLOT_STATE, SLOT_SENT);
+  if (++_head == _slots) _head = 0;
+  if (--_count == 0) _storage->commit();
+}
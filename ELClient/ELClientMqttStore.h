@@ -0,0 +1,116 @@
+/*! \file ELClientMqttStore.h
+    \brief Definitions for ELClientMqttStore, the store-and-forward queue of ELClientMqtt
+*/
+
+#ifndef _EL_CLIENT_MQTT_STORE_H_
+#define _EL_CLIENT_MQTT_STORE_H_
+
+#include <Arduino.h>
+
+#ifndef ELCLIENT_MQTT_STORE_SLOT
+#define ELCLIENT_MQTT_STORE_SLOT 64 /**< Bytes per stored message, at most 261: 6 of them are used for the header, the rest for topic and data */
+#endif
+
+// Byte-addressed storage that an ELClientMqttStore keeps its messages in
+class ELClientStorage {
+  public:
+    // Size in bytes
+    virtual uint16_t length(void) = 0;
+    virtual uint8_t read(uint16_t addr) = 0;
+    virtual void write(uint16_t addr, uint8_t value) = 0;
+    // Make the writes so far persistent, for storage that buffers them
+    virtual void commit(void) {}
+};
+
+// Storage in a RAM buffer, messages are kept across broker outages but not across resets
+class ELClientRamStorage : public ELClientStorage {
+  public:
+    ELClientRamStorage(uint8_t* buf, uint16_t size) : _buf(buf), _size(size) {}
+    uint16_t length(void) { return _size; }
+    uint8_t read(uint16_t addr) { return _buf[addr]; }
+    void write(uint16_t addr, uint8_t value) { _buf[addr] = value; }
+
+  private:
+    uint8_t* _buf; /**< Storage */
+    uint16_t _size; /**< Size of _buf */
+};
+
+// Storage in a range of the EEPROM, messages are kept across resets. Works with the EEPROM
+// object of the Arduino cores, bytes are only written when they change, e.g.
+//   #include <EEPROM.h>
+//   ELClientEepromStorage<EEPROMClass> mqttStorage(EEPROM, 512, 512);
+// ESP8266 and ESP32 emulate the EEPROM in a flash sector: the sketch calls EEPROM.begin(size)
+// first and commit() writes the sector back. This is also the flash backend of the store on
+// those chips, there is no separate one.
+template<class E>
+class ELClientEepromStorage : public ELClientStorage {
+  public:
+    ELClientEepromStorage(E& eeprom, uint16_t base, uint16_t size) :
+      _eeprom(eeprom), _base(base), _size(size), _dirty(false) {}
+    uint16_t length(void) { return _size; }
+    uint8_t read(uint16_t addr) { return _eeprom.read(_base + addr); }
+    void write(uint16_t addr, uint8_t value) {
+      if (_eeprom.read(_base + addr) == value) return;
+      _eeprom.write(_base + addr, value);
+      _dirty = true;
+    }
+    void commit(void) {
+#if defined(ESP8266) || defined(ESP32)
+      if (_dirty) _eeprom.commit();
+#endif
+      _dirty = false;
+    }
+
+  private:
+    E& _eeprom; /**< EEPROM object */
+    uint16_t _base; /**< First address of the range */
+    uint16_t _size; /**< Size of the range */
+    boolean _dirty; /**< Bytes were written since the last commit */
+};
+
+// Ring of messages in an ELClientStorage, split into slots of ELCLIENT_MQTT_STORE_SLOT bytes.
+// Slots are written in turn and marked as sent in place, so every slot is written about equally
+// often (wear levelling) and nothing but the slots themselves needs to be kept: begin() finds
+// the order again from the sequence numbers in the slots. When all slots hold messages the
+// oldest one is dropped for a new one.
+// The storage is committed after every push and once the store is empty again, not after every
+// pop, to save flash erase cycles. A reset in the middle of a replay sends the messages replayed
+// since the last commit once more.
+class ELClientMqttStore {
+  public:
+    ELClientMqttStore(ELClientStorage* storage);
+
+    // Find the messages left in the storage, e.g. from before a reset. ELClientMqtt::setStore
+    // calls it.
+    void begin(void);
+    // Drop all messages
+    void clear(void);
+    // Add a message, false if topic and data do not fit into a slot
+    boolean push(const char* topic, boolean topicP, const uint8_t* data, boolean dataP,
+        uint16_t len, uint8_t qos, uint8_t retain);
+    // Copy the oldest message, topic gets a terminating null and needs ELCLIENT_MQTT_STORE_SLOT
+    // bytes, as does data. False if the store is empty.
+    boolean front(char* topic, uint8_t* data, uint8_t* len, uint8_t* qos, uint8_t* retain);
+    // Mark the oldest message as sent
+    void pop(void);
+
+    // Messages in the store
+    uint16_t count(void) { return _count; }
+    // Messages the store can hold
+    uint16_t capacity(void) { return _slots; }
+    // Messages dropped because they were too long or the store was full
+    uint16_t dropped(void) { return _dropped; }
+
+  private:
+    ELClientStorage* _storage; /**< Storage of the slots */
+    uint16_t _slots; /**< Number of slots */
+    uint16_t _head; /**< Slot of the oldest message */
+    uint16_t _count; /**< Messages in the store */
+    uint16_t _seq; /**< Sequence number of the next message */
+    uint16_t _dropped; /**< Messages dropped */
+    uint8_t slotState(uint16_t slot);
+    uint16_t slotSeq(uint16_t slot);
+    void copy(uint16_t addr, const char* src, boolean progmem, uint8_t len);
+};
+
+#endif // _EL_CLIENT_MQTT_STORE_H_
@@ -29,6 +29,7 @@ class ELClientResponse {
     uint16_t argc() { return _cmd->argc; } /**< Get number of arguments  */
     uint16_t cmd() { return _cmd->cmd; } /**< Get command  */
     uint32_t value() { return _cmd->value; } /**< Get returned value  */
+    ELClientPacket* packet() { return _cmd; } /**< Get the packet, e.g. to hold it with ELClient::Acquire  */
 
     // Return the length of the next argument
     uint16_t argLen() { return *(uint16_t*)_arg_ptr; } /**< Get length of argument  */
@@ -27,6 +27,7 @@ ELClientRest::ELClientRest(ELClient *e)
 {
   _elc = e;
   remote_instance = -1;
+  _held = NULL;
 }
 
 /*! restCallback(void *res)
@@ -35,7 +36,8 @@ ELClientRest::ELClientRest(ELClient *e)
 @note Internal library function
 @param res
 	Pointer to ELClientResponse structure
-@warning The content of the response structure is overwritten when the next package arrives!
+@warning The content of the response structure is overwritten when the next package arrives,
+	unless a free receive slot is available to hold it (ELCLIENT_RX_SLOTS > 1)!
 */
 void ELClientRest::restCallback(void *res)
 {
@@ -44,12 +46,13 @@ void ELClientRest::restCallback(void *res)
   ELClientResponse *resp = (ELClientResponse *)res;
 
   resp->popArg(&_status, sizeof(_status));
-  if (_elc->_debugEn) {
-    _elc->_debug->print("REST code ");
-    _elc->_debug->println(_status);
-  }
+  _elc->Trace(ELC_TRACE_APP, 0, CMD_REST_REQUEST, _status);
 
   _len = resp->popArgPtr(&_data);
+
+  // keep the body until getResponse copies it, if a receive slot is free
+  _elc->Release(_held);
+  _held = _elc->Acquire(resp->packet()) ? resp->packet() : NULL;
 }
 
 /*! begin(const char* host, uint16_t port, boolean security)
@@ -64,9 +67,13 @@ void ELClientRest::restCallback(void *res)
 	Flag if secure connection should be established
 @warning Port MUST NOT be 80, 23 or 2323, as these ports are already used by EL-CLIENT on the ESP8266.
 	Max 4 connections are supported!
+@return <code>ELClientFuture<int></code>
+	Completes with 0 on success, a negative error code if the set-up failed or -1 on timeout.
+	If the ELClient callback table is full (ELCLIENT_MAX_CALLBACKS) nothing is sent and the
+	future fails right away with -1 and state() ELC_PENDING_UNKNOWN.
 @par Example
 @code
-	int err = rest.begin("www.timeapi.org");
+	int err = rest.begin("www.timeapi.org"); // waits for the result
 	if (err != 0) 
 	{
 		Serial.print("REST begin failed: ");
@@ -75,23 +82,32 @@ void ELClientRest::restCallback(void *res)
 	}
 @endcode
 */
-int ELClientRest::begin(const char* host, uint16_t port, boolean security)
+ELClientFuture<int> ELClientRest::begin(const char* host, uint16_t port, boolean security)
 {
   uint8_t sec = !!security;
   restCb.attach(this, &ELClientRest::restCallback);
+  setupCb.attach(this, &ELClientRest::setupCallback);
 
-  _elc->Request(CMD_REST_SETUP, (uint32_t)&restCb, 3);
-  _elc->Request(host, strlen(host));
-  _elc->Request(&port, 2);
-  _elc->Request(&sec, 1);
-  _elc->Request();
+  uint32_t handle = _elc->Handle(&restCb);
+  if (handle == 0) return ELClientFuture<int>(_elc, 0, (uint32_t)-1);
+  _elc->send(CMD_REST_SETUP, handle, host, port, sec);
 
-  ELClientPacket *pkt = _elc->WaitReturn();
-  if (pkt && (int32_t)pkt->value >= 0) {
-    remote_instance = pkt->value;
-    return 0;
-  }
-  return (int)pkt->value;
+  return ELClientFuture<int>(_elc, _elc->Expect(ESP_TIMEOUT, &setupCb), (uint32_t)-1);
+}
+
+/*! setupCallback(void *pending)
+@brief Completion hook of the CMD_REST_SETUP request sent by begin()
+@details Stores the connection number and turns it into the 0 that begin() reports on success.
+@note Internal library function
+@param pending
+	Pointer to the ELClientPending entry of the request
+*/
+void ELClientRest::setupCallback(void *pending)
+{
+  ELClientPending *p = (ELClientPending *)pending;
+  if (p->state != ELC_PENDING_DONE || (int32_t)p->value < 0) return;
+  remote_instance = p->value;
+  p->value = 0;
 }
 
 /*! request(const char* path, const char* method, const char* data, int len)
@@ -113,20 +129,15 @@ void ELClientRest::request(const char* path, const char* method, const char* dat
 {
   _status = 0;
   if (remote_instance < 0) return;
-  if (data != 0 && len > 0) _elc->Request(CMD_REST_REQUEST, remote_instance, 3);
-  else                      _elc->Request(CMD_REST_REQUEST, remote_instance, 2);
-  _elc->Request(method, strlen(method));
-  _elc->Request(path, strlen(path));
-  if (data != NULL && len > 0) {
-    _elc->Request(data, len);
-  }
-
-  _elc->Request();
+  if (data != NULL && len > 0)
+    _elc->send(CMD_REST_REQUEST, remote_instance, method, path, ELClient::span(data, len));
+  else
+    _elc->send(CMD_REST_REQUEST, remote_instance, method, path);
 }
 
 /*! request(const char* path, const char* method, const char* data)
 @brief Send request to REST server.
-@details The data must be null-terminated.
+@details The data must be null-terminated, NULL sends no data.
 @param path
 	Path that extends the URL of the REST request (command or data for the REST server)
 @param method
@@ -140,7 +151,7 @@ void ELClientRest::request(const char* path, const char* method, const char* dat
 */
 void ELClientRest::request(const char* path, const char* method, const char* data)
 {
-  request(path, method, data, strlen(data));
+  request(path, method, data, data ? strlen(data) : 0);
 }
 
 /*! get(const char* path, const char* data)
@@ -229,10 +240,7 @@ void ELClientRest::del(const char* path) { request(path, "DELETE", 0); }
 void ELClientRest::setHeader(const char* value)
 {
   uint8_t header_index = HEADER_GENERIC;
-  _elc->Request(CMD_REST_SETHEADER, remote_instance, 2);
-  _elc->Request(&header_index, 1);
-  _elc->Request(value, strlen(value));
-  _elc->Request();
+  _elc->send(CMD_REST_SETHEADER, remote_instance, header_index, value);
 }
 
 /*! setContentType(const char* value)
@@ -248,10 +256,7 @@ void ELClientRest::setHeader(const char* value)
 void ELClientRest::setContentType(const char* value)
 {
   uint8_t header_index = HEADER_CONTENT_TYPE;
-  _elc->Request(CMD_REST_SETHEADER, remote_instance, 2);
-  _elc->Request(&header_index, 1);
-  _elc->Request(value, strlen(value));
-  _elc->Request();
+  _elc->send(CMD_REST_SETHEADER, remote_instance, header_index, value);
 }
 
 /*! setUserAgent(const char* value)
@@ -267,10 +272,7 @@ void ELClientRest::setContentType(const char* value)
 void ELClientRest::setUserAgent(const char* value)
 {
   uint8_t header_index = HEADER_USER_AGENT;
-  _elc->Request(CMD_REST_SETHEADER, remote_instance, 2);
-  _elc->Request(&header_index, 1);
-  _elc->Request(value, strlen(value));
-  _elc->Request();
+  _elc->send(CMD_REST_SETHEADER, remote_instance, header_index, value);
 }
 
 /*! getResponse(char* data, uint16_t maxLen)
@@ -322,6 +324,8 @@ uint16_t ELClientRest::getResponse(char* data, uint16_t maxLen)
 {
   if (_status == 0) return 0;
   memcpy(data, _data, _len>maxLen?maxLen:_len);
+  _elc->Release(_held);
+  _held = NULL;
   int16_t s = _status;
   _status = 0;
   return s;
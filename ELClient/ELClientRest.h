@@ -26,14 +26,13 @@ typedef enum {
 // The ELClientRest class does not support concurrent requests to the same server because
 // only a single response can be recevied at a time and the responses of the two requests
 // may arrive out of order.
-// A major limitation of the REST class is that it does not store the response body. The
-// response status is saved in the class instance, so after a request completes and before
-// the next request is made a call to getResponse will return the status. However, only a pointer
-// to the response body is saved, which means that if any other message arrives and is
-// processed then the response body is overwritten by it. What this means is that if you
-// need the response body you best use waitResponse or ensure that any call to ELClient::process
-// is followed by a call to getResponse. Ideally someone improves this class to take a callback
-// into the user's sketch?
+// The REST class does not copy the response body. The response status is saved in the class
+// instance, so after a request completes and before the next request is made a call to
+// getResponse will return the status. Only a pointer to the response body is saved: with
+// ELCLIENT_RX_SLOTS > 1 the receive slot holding it is acquired until getResponse copies it
+// out, with a single slot any other message that arrives and is processed overwrites it. In
+// that case you best use waitResponse or ensure that any call to ELClient::process is followed
+// by a call to getResponse.
 // Another limitation is that the response body is 100 chars long at most, this is due to the
 // limitation of the SLIP protocol buffer available.
 class ELClientRest {
@@ -42,9 +41,11 @@ class ELClientRest {
 
     // Initialize communication to a remote server, this communicates with esp-link but does not
     // open a connection to the remote server. Host may be a hostname or an IP address,
-    // security causes HTTPS to be used (not yet supported). Returns 0 if the set-up is
-    // successful, returns a negative error code if it failed.
-    int begin(const char* host, uint16_t port=80, boolean security=false);
+    // security causes HTTPS to be used (not yet supported). The returned future completes with
+    // 0 if the set-up is successful, with a negative error code if it failed (-1 on timeout or
+    // when ELClient has no free callback handle).
+    // Converting it to int waits for the result.
+    ELClientFuture<int> begin(const char* host, uint16_t port=80, boolean security=false);
 
     // Make a request to the remote server. The data must be null-terminated
     void request(const char* path, const char* method, const char* data=NULL);
@@ -86,10 +87,13 @@ class ELClientRest {
     ELClient *_elc; /**< ELClient instance */
     void restCallback(void* resp);
     FP<void, void*> restCb; /**< Pointer to external callback function */
+    void setupCallback(void* pending);
+    FP<void, void*> setupCb; /**< Completion hook of the CMD_REST_SETUP request */
 
     int16_t _status; /**< Connection status */
     uint16_t _len; /**< Number of sent/received bytes */
     void *_data; /**< Buffer for received data */
+    ELClientPacket *_held; /**< Packet held with ELClient::Acquire that contains _data */
 
 
 };
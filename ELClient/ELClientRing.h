@@ -0,0 +1,86 @@
+/*! \file ELClientRing.h
+    \brief Definitions for ELClientRing, a lock-free receive ring fed from an interrupt
+*/
+
+#ifndef _EL_CLIENT_RING_H_
+#define _EL_CLIENT_RING_H_
+
+#include <Arduino.h>
+
+// Ring indices run freely and are masked on access. They must be loaded and stored in one
+// instruction, so AVR uses 8-bit indices (rings of up to 128 bytes).
+#ifdef __AVR__
+typedef uint8_t ELClientRingIndex; /**< Index type of the receive ring */
+#else
+typedef uint16_t ELClientRingIndex; /**< Index type of the receive ring */
+#endif
+
+// Single-producer/single-consumer byte ring. The producer (an RX interrupt, or
+// SC16IS750::__isr) only writes _head and the consumer (ELClient::Process) only writes _tail,
+// so neither side needs to disable interrupts. The acquire/release accesses order the data
+// bytes against the index updates on multi-core and out-of-order targets.
+class ELClientRing {
+  public:
+    //== Producer side, call from the interrupt only
+    // Add a byte, returns false and counts an overflow if the ring is full
+    boolean push(uint8_t c) {
+      ELClientRingIndex head = _head;
+      if ((ELClientRingIndex)(head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE)) > _mask) {
+        _overflows++;
+        return false;
+      }
+      _buf[head & _mask] = c;
+      __atomic_store_n(&_head, (ELClientRingIndex)(head + 1), __ATOMIC_RELEASE);
+      return true;
+    }
+
+    //== Consumer side, call from loop() only
+    // Number of bytes in the ring
+    ELClientRingIndex available(void) {
+      return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) - _tail;
+    }
+    // Move up to len bytes into data with at most two memcpy, returns the number of bytes
+    ELClientRingIndex read(uint8_t *data, ELClientRingIndex len) {
+      ELClientRingIndex tail = _tail;
+      ELClientRingIndex n = __atomic_load_n(&_head, __ATOMIC_ACQUIRE) - tail;
+      if (n > len) n = len;
+      ELClientRingIndex pos = tail & _mask;
+      ELClientRingIndex first = _mask + 1 - pos;
+      if (first > n) first = n;
+      memcpy(data, _buf + pos, first);
+      memcpy(data + first, _buf, n - first);
+      __atomic_store_n(&_tail, (ELClientRingIndex)(tail + n), __ATOMIC_RELEASE);
+      return n;
+    }
+    // Number of bytes dropped because the ring was full
+    uint16_t overflows(void) { return _overflows; }
+
+  protected:
+    ELClientRing(uint8_t *buf, ELClientRingIndex size) :
+      _buf(buf), _mask(size - 1), _head(0), _tail(0), _overflows(0) {} /**< Use ELClientRingBuffer */
+
+  private:
+    uint8_t *_buf; /**< Ring storage */
+    ELClientRingIndex _mask; /**< Size of the ring - 1 */
+    volatile ELClientRingIndex _head; /**< Next byte to write, owned by the producer */
+    volatile ELClientRingIndex _tail; /**< Next byte to read, owned by the consumer */
+    volatile uint16_t _overflows; /**< Bytes dropped by push */
+};
+
+// Receive ring with storage for Size bytes, Size must be a power of two (at most 128 on AVR).
+// Hand it to ELClient::SetReceiveRing and feed it from the RX interrupt, e.g.
+//   ELClientRingBuffer<128> rxRing;
+//   void irqPin() { i2cuart.__isr(); } // or rxRing.push(UDR) in a UART RX interrupt
+//   i2cuart.SetReceiveRing(&rxRing); esp.SetReceiveRing(&rxRing);
+template<ELClientRingIndex Size>
+class ELClientRingBuffer : public ELClientRing {
+  static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "ELClientRingBuffer size must be a power of two");
+  static_assert(Size <= (ELClientRingIndex)~(ELClientRingIndex)0 / 2 + 1, "ELClientRingBuffer size exceeds the index range");
+  public:
+    ELClientRingBuffer() : ELClientRing(_store, Size) {}
+
+  private:
+    uint8_t _store[Size]; /**< Ring storage */
+};
+
+#endif // _EL_CLIENT_RING_H_
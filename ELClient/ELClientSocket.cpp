@@ -25,6 +25,7 @@ ELClientSocket::ELClientSocket(ELClient *e)
 {
 	_elc = e;
 	remote_instance = -1;
+	_held = NULL;
 }
 
 /*! socketCallback(void *res)
@@ -34,7 +35,8 @@ ELClientSocket::ELClientSocket(ELClient *e)
 @note Internal library function
 @param res
 	Pointer to ELClientResponse structure
-@warning The content of the response structure is overwritten when the next package arrives!
+@warning The content of the response structure is overwritten when the next package arrives,
+	unless a free receive slot is available to hold it (ELCLIENT_RX_SLOTS > 1)!
 */
 void ELClientSocket::socketCallback(void *res) 
 {
@@ -68,6 +70,9 @@ void ELClientSocket::socketCallback(void *res)
 			Serial.print(" data length: "+String(argLen));
 		#endif
 		resp->popArgPtr(&_data);
+		// keep the data until getResponse copies it, if a receive slot is free
+		_elc->Release(_held);
+		_held = _elc->Acquire(resp->packet()) ? resp->packet() : NULL;
 		#ifdef DEBUG_EN
 			_data[_len] = '\0';
 			Serial.print(" data: "+String(_data));
@@ -97,6 +102,11 @@ void ELClientSocket::socketCallback(void *res)
 	(optional) Pointer to callback function that is called if data after data has been sent, received or if an error occured
 @warning Port MUST NOT be 80, 23 or 2323, as these ports are already used by EL-CLIENT on the ESP8266.
 	Max 4 connections are supported!
+@return <code>ELClientFuture<int></code>
+	Completes with the connection number on success, a negative error code if the set-up failed or -1 on timeout.
+	Converting the future to int waits for the result. If the ELClient callback table is full
+	(ELCLIENT_MAX_CALLBACKS) nothing is sent and the future fails right away with -1 and state()
+	ELC_PENDING_UNKNOWN.
 @par Example1
 @code
 	// Setup a simple client to send data and disconnect after data was sent
@@ -118,7 +128,7 @@ void ELClientSocket::socketCallback(void *res)
 	socketConnNum = socket.begin(socketServer, socketPort, SOCKET_UDP, socketCb);
 @endcode
 */
-int ELClientSocket::begin(const char* host, uint16_t port, uint8_t sock_mode, void (*userCb)(uint8_t resp_type, uint8_t client_num, uint16_t len, char *data)) 
+ELClientFuture<int> ELClientSocket::begin(const char* host, uint16_t port, uint8_t sock_mode, void (*userCb)(uint8_t resp_type, uint8_t client_num, uint16_t len, char *data)) 
 {
 	if (userCb != 0) 
 	{
@@ -127,21 +137,29 @@ int ELClientSocket::begin(const char* host, uint16_t port, uint8_t sock_mode, vo
 	}
 
 	socketCb.attach(this, &ELClientSocket::socketCallback);
+	setupCb.attach(this, &ELClientSocket::setupCallback);
 
-	_elc->Request(CMD_SOCKET_SETUP, (uint32_t)&socketCb, 3);
-	_elc->Request(host, strlen(host));
-	_elc->Request(&port, 2);
-	_elc->Request(&sock_mode, 1);
-	_elc->Request();
+	uint32_t handle = _elc->Handle(&socketCb);
+	if (handle == 0) return ELClientFuture<int>(_elc, 0, (uint32_t)-1);
+	_elc->send(CMD_SOCKET_SETUP, handle, host, port, sock_mode);
 
-	ELClientPacket *pkt = _elc->WaitReturn();
+	return ELClientFuture<int>(_elc, _elc->Expect(ESP_TIMEOUT, &setupCb), (uint32_t)-1);
+}
 
-	if (pkt && (int32_t)pkt->value >= 0) 
+/*! setupCallback(void *pending)
+@brief Completion hook of the CMD_SOCKET_SETUP request sent by begin()
+@details Stores the connection number for send().
+@note Internal library function
+@param pending
+	Pointer to the ELClientPending entry of the request
+*/
+void ELClientSocket::setupCallback(void *pending)
+{
+	ELClientPending *p = (ELClientPending *)pending;
+	if (p->state == ELC_PENDING_DONE && (int32_t)p->value >= 0)
 	{
-		remote_instance = pkt->value;
-		// return 0;
+		remote_instance = p->value;
 	}
-	return (int)pkt->value;
 }
 
 /*! send(const char* data, int len)
@@ -161,14 +179,14 @@ void ELClientSocket::send(const char* data, int len)
 {
 	_status = 0;
 	if (remote_instance < 0) return;
-	_elc->Request(CMD_SOCKET_SEND, remote_instance, 2);
-	_elc->Request(data, strlen(data));
 	if (data != NULL && len > 0) 
 	{
-		_elc->Request(data, len);
+		_elc->send(CMD_SOCKET_SEND, remote_instance, data, ELClient::span(data, len));
+	}
+	else
+	{
+		_elc->send(CMD_SOCKET_SEND, remote_instance, data);
 	}
-
-	_elc->Request();
 }
 
 /*! send(const char* data)
@@ -237,6 +255,8 @@ uint16_t ELClientSocket::getResponse(uint8_t *resp_type, uint8_t *client_num, ch
 {
 	if (_status == 0) return 0;
 	memcpy(data, _data, _len>maxLen?maxLen:_len);
+	_elc->Release(_held);
+	_held = NULL;
 	*resp_type = _resp_type;
 	*client_num = _client_num;
 	_status = 0;
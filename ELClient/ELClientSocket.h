@@ -45,11 +45,12 @@ class ELClientSocket {
 		// open a connection to the remote server. Host may be a hostname or an IP address.
 		// Port needs to be defined different from usual HTTP/HTTPS/FTP/SSH ports
 		// sock_mode defines whether the socket act as a client (with or without receiver) or as a server
-		// Returns 0 if the set-up is
-		// successful, returns a negative error code if it failed.
+		// The returned future completes with the connection number if the set-up is
+		// successful, with a negative error code if it failed (-1 on timeout or when ELClient has no free
+		// callback handle). Converting it to int waits for the result.
 		// Optional a pointer to a callback function be added. The callback function will be called after data is sent out, 
 		// after data was received or when an error occured. See example code port how to use it.
-		int begin(const char* host, uint16_t port, uint8_t sock_mode, void (*userCb)(uint8_t resp_type, uint8_t client_num, uint16_t len, char *data)=0);
+		ELClientFuture<int> begin(const char* host, uint16_t port, uint8_t sock_mode, void (*userCb)(uint8_t resp_type, uint8_t client_num, uint16_t len, char *data)=0);
 
 		// Send data to the remote server. The data must be null-terminated
 		void send(const char* data);
@@ -74,6 +75,8 @@ class ELClientSocket {
 		ELClient *_elc; /**< ELClient instance */
 		void socketCallback(void* resp);
 		FP<void, void*> socketCb; /**< Pointer to external callback function */
+		void setupCallback(void* pending);
+		FP<void, void*> setupCb; /**< Completion hook of the CMD_SOCKET_SETUP request */
 
 		/*! void (* _userCallback)(uint8_t resp_type, uint8_t client_num, uint16_t len, char *data)
 		@brief Callback function when data is sent or received
@@ -143,6 +146,7 @@ class ELClientSocket {
 		int16_t _status; /**< Connection status */
 		uint16_t _len; /**< Number of sent/received bytes */
 		void *_data; /**< Buffer for received data */
+		ELClientPacket *_held; /**< Packet held with ELClient::Acquire that contains _data */
 		uint8_t _resp_type; /**< Response type: 0 = send, 1 = receive; 2 = reset connection, 3 = connection */
 		uint8_t _client_num; /**< Connection number, value can be 0 to 3 */
 };
@@ -25,7 +25,9 @@ struct _Handler
   struct _Handler * next;     /**< next handler */
 };
 
-static ELClientWebServer * ELClientWebServer::instance = 0;
+constexpr char webCbName[] = "webCb"; /**< Name of the custom callback esp-link sends web requests to */
+
+ELClientWebServer * ELClientWebServer::instance = 0;
 
 /*! ELClientWebServer(ELClient* elc)
 @brief Constructor for ELClientWebServer
@@ -36,7 +38,33 @@ static ELClientWebServer * ELClientWebServer::instance = 0;
 	ELClientWebServer webServer(&esp);
 @endcode
 */
-ELClientWebServer::ELClientWebServer(ELClient* elc) :_elc(elc),handlers(0), arg_ptr(0) {
+#ifndef ELCLIENT_NO_HEAP
+ELClientWebServer::ELClientWebServer(ELClient* elc) :_elc(elc), arg_ptr(0), handlers(0), pool(0), poolSize(0) {
+  // save the current packet handler and register a new one
+  nextPacketHandler = _elc->GetCallbackPacketHandler();
+  _elc->SetCallbackPacketHandler(ELClientWebServer::webServerPacketHandler);
+  instance = this;
+}
+#endif
+
+/*! ELClientWebServer(ELClient* elc, ELClientWebHandler* pool, uint8_t poolSize)
+@brief Constructor for ELClientWebServer with a fixed handler pool
+@details The URL handlers are kept in the pool instead of being allocated on the heap.
+	ELClientWebServerStatic provides the pool as part of the object.
+@param elc
+	Pointer to ELClient instance
+@param pool
+	Array of poolSize handler entries
+@param poolSize
+	Maximum number of URL handlers
+@par Example
+@code
+	ELClientWebServerStatic<3> webServer(&esp);
+@endcode
+*/
+ELClientWebServer::ELClientWebServer(ELClient* elc, ELClientWebHandler* pool, uint8_t poolSize) :
+  _elc(elc), arg_ptr(0), handlers(0), pool(pool), poolSize(poolSize) {
+  memset(pool, 0, poolSize * sizeof(ELClientWebHandler));
   // save the current packet handler and register a new one
   nextPacketHandler = _elc->GetCallbackPacketHandler();
   _elc->SetCallbackPacketHandler(ELClientWebServer::webServerPacketHandler);
@@ -55,7 +83,7 @@ ELClientWebServer::ELClientWebServer(ELClient* elc) :_elc(elc),handlers(0), arg_
 	no example yet
 @endcode
 */
-static uint8_t ELClientWebServer::webServerPacketHandler(ELClientPacket * packet)
+uint8_t ELClientWebServer::webServerPacketHandler(ELClientPacket * packet)
 {
   if( packet->cmd == CMD_WEB_REQ_CB )
   {
@@ -104,8 +132,15 @@ void ELClientWebServer::setup()
 */
 void ELClientWebServer::registerHandler(const char * URL, WebServerCallback callback)
 {
+  if( pool != 0 )
+  {
+    poolRegister(URL, strlen(URL), false, callback);
+    return;
+  }
+#ifndef ELCLIENT_NO_HEAP
   String s = URL;
   registerHandler(s, callback);
+#endif
 }
 
 /*! registerHandler(const __FlashStringHelper * URL, WebServerCallback callback)
@@ -126,8 +161,15 @@ void ELClientWebServer::registerHandler(const char * URL, WebServerCallback call
 */
 void ELClientWebServer::registerHandler(const __FlashStringHelper * URL, WebServerCallback callback)
 {
+  if( pool != 0 )
+  {
+    poolRegister((const char *)URL, strlen_P((const char *)URL), true, callback);
+    return;
+  }
+#ifndef ELCLIENT_NO_HEAP
   String s = URL;
   registerHandler(s, callback);
+#endif
 }
 
 // registers a new handler
@@ -145,6 +187,12 @@ void ELClientWebServer::registerHandler(const __FlashStringHelper * URL, WebServ
 */
 void ELClientWebServer::registerHandler(const String &URL, WebServerCallback callback)
 {
+  if( pool != 0 )
+  {
+    poolRegister(URL.c_str(), URL.length(), false, callback);
+    return;
+  }
+#ifndef ELCLIENT_NO_HEAP
   unregisterHandler(URL);
   
   struct _Handler * hnd = new struct _Handler(); // "new" is used here instead of malloc to call String destructor at freeing. DOn't use malloc/free.
@@ -152,6 +200,7 @@ void ELClientWebServer::registerHandler(const String &URL, WebServerCallback cal
   hnd->callback = callback;   // callback
   hnd->next = handlers;       // next handler
   handlers = hnd;             // change the first handler
+#endif
 }
 
 /*! unregisterHandler(const char * URL)
@@ -165,8 +214,17 @@ void ELClientWebServer::registerHandler(const String &URL, WebServerCallback cal
 */
 void ELClientWebServer::unregisterHandler(const char * URL)
 {
+  if( pool != 0 )
+  {
+    ELClientWebHandler *hnd = poolFind(URL, strlen(URL), false);
+    if( hnd != 0 )
+      hnd->URL[0] = 0;
+    return;
+  }
+#ifndef ELCLIENT_NO_HEAP
   String s = URL;
   unregisterHandler(s);
+#endif
 }
 
 /*! unregisterHandler(const __FlashStringHelper * URL)
@@ -180,8 +238,17 @@ void ELClientWebServer::unregisterHandler(const char * URL)
 */
 void ELClientWebServer::unregisterHandler(const __FlashStringHelper * URL)
 {
+  if( pool != 0 )
+  {
+    ELClientWebHandler *hnd = poolFind((const char *)URL, strlen_P((const char *)URL), true);
+    if( hnd != 0 )
+      hnd->URL[0] = 0;
+    return;
+  }
+#ifndef ELCLIENT_NO_HEAP
   String s = URL;
   unregisterHandler(s);
+#endif
 }
 
 // unregisters a previously registered handler
@@ -196,6 +263,12 @@ void ELClientWebServer::unregisterHandler(const __FlashStringHelper * URL)
 */
 void ELClientWebServer::unregisterHandler(const String &URL)
 {
+  if( pool != 0 )
+  {
+    unregisterHandler(URL.c_str());
+    return;
+  }
+#ifndef ELCLIENT_NO_HEAP
   struct _Handler *prev = 0;
   struct _Handler *hnd = handlers;
   while( hnd != 0 )
@@ -212,6 +285,102 @@ void ELClientWebServer::unregisterHandler(const String &URL)
     prev = hnd;
     hnd = hnd->next;
   }
+#endif
+}
+
+/*! poolFind(const char * URL, uint16_t len, boolean progmem)
+@brief Look up a URL in the handler pool
+@note
+	This function is usually not needed for applications.
+@param URL
+	URL to look for, not necessarily 0 terminated
+@param len
+	Length of the URL
+@param progmem
+	True if URL is stored in program memory
+@return <code>ELClientWebHandler *</code>
+	Pool entry of the URL or 0 if it is not registered
+*/
+ELClientWebHandler * ELClientWebServer::poolFind(const char * URL, uint16_t len, boolean progmem)
+{
+  if( len >= ELCLIENT_WEB_URL_LEN )
+    return 0;
+  for(uint8_t i=0; i < poolSize; i++)
+  {
+    ELClientWebHandler *hnd = &pool[i];
+    if( hnd->URL[0] == 0 || hnd->URL[len] != 0 )
+      continue;
+    if( progmem ? memcmp_P(hnd->URL, URL, len) == 0 : memcmp(hnd->URL, URL, len) == 0 )
+      return hnd;
+  }
+  return 0;
+}
+
+/*! poolRegister(const char * URL, uint16_t len, boolean progmem, WebServerCallback callback)
+@brief Add or replace a URL handler in the handler pool
+@details The URL is copied into the pool entry. URLs of ELCLIENT_WEB_URL_LEN characters or more
+	and handlers that do not fit into a full pool are dropped.
+@note
+	This function is usually not needed for applications.
+@param URL
+	URL to be handled
+@param len
+	Length of the URL
+@param progmem
+	True if URL is stored in program memory
+@param callback
+	Pointer to callback function to handle request on this URL
+*/
+void ELClientWebServer::poolRegister(const char * URL, uint16_t len, boolean progmem, WebServerCallback callback)
+{
+  if( len == 0 || len >= ELCLIENT_WEB_URL_LEN )
+    return;
+  ELClientWebHandler *hnd = poolFind(URL, len, progmem);
+  for(uint8_t i=0; hnd == 0 && i < poolSize; i++)
+  {
+    if( pool[i].URL[0] == 0 )
+      hnd = &pool[i];
+  }
+  if( hnd == 0 ) // pool is full
+    return;
+  if( progmem )
+    memcpy_P(hnd->URL, URL, len);
+  else
+    memcpy(hnd->URL, URL, len);
+  hnd->URL[len] = 0;
+  hnd->callback = callback;
+}
+
+/*! findHandler(const char * URL, int len)
+@brief Look up the callback of a URL
+@note
+	This function is usually not needed for applications.
+@param URL
+	URL of the request, not 0 terminated
+@param len
+	Length of the URL
+@return <code>WebServerCallback</code>
+	Callback registered for the URL or 0 if there is none
+*/
+WebServerCallback ELClientWebServer::findHandler(const char * URL, int len)
+{
+  if( len < 0 )
+    return 0;
+  if( pool != 0 )
+  {
+    ELClientWebHandler *hnd = poolFind(URL, len, false);
+    return hnd != 0 ? hnd->callback : 0;
+  }
+#ifndef ELCLIENT_NO_HEAP
+  struct _Handler *hnd = handlers;
+  while( hnd != 0 )
+  {
+    if( (int)hnd->URL.length() == len && memcmp( URL, hnd->URL.begin(), len ) == 0 )
+      return hnd->callback;
+    hnd = hnd->next;
+  }
+#endif
+  return 0;
 }
 
 /*! registerCallback()
@@ -230,9 +399,7 @@ void ELClientWebServer::registerCallback()
   // WebServer doesn't send messages to MCU only if asked
   // register here to the web callback
   // periodic reregistration is required in case of ESP8266 reset
-  _elc->Request(CMD_CB_ADD, 100, 1);
-  _elc->Request(F("webCb"), 5);
-  _elc->Request();
+  _elc->sendFrame<ELClientFrame<CMD_CB_ADD, 100, webCbName> >();
 }
 
 /*! processPacket(ELClientPacket *packet)
@@ -258,25 +425,16 @@ void ELClientWebServer::processPacket(ELClientPacket *packet)
   response.popArg(&remote_port, 2); // remote port
   
   char * url;
-  int urlLen = response.popArgPtr(&url);
-  
-  WebServerCallback callback = 0;
+  int urlLen = response.popArgPtr((void**)&url);
   
-  struct _Handler *hnd = handlers;
-  while( hnd != 0 )
-  {
-    if( hnd->URL.length() == urlLen && memcmp( url, hnd->URL.begin(), urlLen ) == 0 )
-    {
-      callback = hnd->callback;
-      break;
-    }
-    hnd = hnd->next;
-  }
+  WebServerCallback callback = findHandler(url, urlLen);
 
-  if( hnd == 0 ) // no handler found for the URL
+  if( callback == 0 ) // no handler found for the URL
   {
+    if( !_elc->_debugEn )
+      return;
     _elc->_debug->print(F("Handler not found for URL:"));
-    
+
     for(int i=0; i < urlLen; i++)
       _elc->_debug->print( url[i] );
     _elc->_debug->println();
@@ -288,7 +446,7 @@ void ELClientWebServer::processPacket(ELClientPacket *packet)
     case WS_BUTTON: // invoked when a button pressed
       {
         char * idPtr;
-        int idLen = response.popArgPtr(&idPtr);
+        int idLen = response.popArgPtr((void**)&idPtr);
   
         char id[idLen+1];
         memcpy(id, idPtr, idLen);
@@ -304,17 +462,19 @@ void ELClientWebServer::processPacket(ELClientPacket *packet)
         while( cnt < response.argc() )
         {
           char * idPtr;
-          int idLen = response.popArgPtr(&idPtr);
+          int idLen = response.popArgPtr((void**)&idPtr);
           int nameLen = strlen(idPtr+1);
           int valueLen = idLen - nameLen -2;
 
-          arg_ptr = (char *)malloc(valueLen+1);
+          // terminate the value in place, the byte after it (padding or the length of the
+          // next argument) is restored afterwards
+          arg_ptr = idPtr + 2 + nameLen;
+          char next = arg_ptr[valueLen];
           arg_ptr[valueLen] = 0;
-          memcpy(arg_ptr, idPtr + 2 + nameLen, valueLen);
 
           callback(SET_FIELD, idPtr+1, nameLen);
-  
-          free(arg_ptr);
+
+          arg_ptr[valueLen] = next;
           arg_ptr = 0;
           cnt++;
         }
@@ -17,13 +17,29 @@ typedef enum
 // callback funtion
 typedef void (*WebServerCallback)(WebServerCommand command, char * data, int dataLen); /**< Typedef for web server callback */
 
-struct _Handlers;
+#ifndef ELCLIENT_WEB_URL_LEN
+#define ELCLIENT_WEB_URL_LEN 32 /**< Size of the URL of a handler in an ELClientWebServerStatic pool, including the terminating 0 */
+#endif
+
+// handler descriptor of a fixed pool, see ELClientWebServerStatic
+struct ELClientWebHandler
+{
+  char URL[ELCLIENT_WEB_URL_LEN]; /**< handler URL, empty if the entry is free */
+  WebServerCallback callback;     /**< handler callback */
+};
+
+struct _Handler;
 
 // This class implements function for web-server
 class ELClientWebServer {
 public:
+#ifndef ELCLIENT_NO_HEAP
   // Initialize with an ELClient object
   ELClientWebServer(ELClient* elc);
+#endif
+  // Initialize with an ELClient object and a fixed pool of poolSize handlers instead of the heap,
+  // see ELClientWebServerStatic
+  ELClientWebServer(ELClient* elc, ELClientWebHandler* pool, uint8_t poolSize);
   
   // initializes the web-server
   void    setup();
@@ -100,6 +116,25 @@ private:
   char *                     arg_ptr; /**< Pointer to arguments */
   
   struct _Handler          * handlers; /**< Structure of callback function pointers */
+  ELClientWebHandler       * pool; /**< Fixed handler pool, NULL if the handlers are on the heap */
+  uint8_t                    poolSize; /**< Number of entries in pool */
+
+  ELClientWebHandler * poolFind(const char * URL, uint16_t len, boolean progmem);
+  void    poolRegister(const char * URL, uint16_t len, boolean progmem, WebServerCallback callback);
+  WebServerCallback findHandler(const char * URL, int len);
+};
+
+// A web-server whose URL handlers live in a pool inside the object instead of on the heap, e.g.
+//   ELClientWebServerStatic<4> webServer(&esp);
+// URLs are copied into the pool and may be up to ELCLIENT_WEB_URL_LEN-1 characters long.
+template<uint8_t MaxHandlers>
+class ELClientWebServerStatic : public ELClientWebServer {
+public:
+  // Initialize with an ELClient object
+  ELClientWebServerStatic(ELClient* elc) : ELClientWebServer(elc, _handlers, MaxHandlers) {}
+
+private:
+  ELClientWebHandler _handlers[MaxHandlers]; /**< Handler pool */
 };
 
 #endif // _EL_CLIENT_WEB_SERVER_H_
@@ -42,6 +42,8 @@ SC16IS750::SC16IS750(uint8_t prtcl, uint8_t addr_sspin)
 		device_address_sspin = addr_sspin;
 	}
 	peek_flag = 0;
+	rx_level = 0;
+	rx_ring = NULL;
 //	timeout = 1000;
 }
 
@@ -70,9 +72,15 @@ void SC16IS750::begin(uint32_t baud)
     SetLine(8,0,1);
 }
 
+//Bytes that can be read. While bytes read earlier by RXLVL are left this returns that count
+//without a bus access, it may be lower than the FIFO level then but never 0 while the FIFO
+//holds data: once the count runs out RXLVL is read again.
 int SC16IS750::available(void)
 {
-    return FIFOAvailableData();
+    if (rx_level == 0) {
+        rx_level = FIFOAvailableData();
+    }
+    return rx_level + peek_flag;
 }
 
 int SC16IS750::read(void)
@@ -87,7 +95,32 @@ int SC16IS750::read(void)
 
 size_t SC16IS750::write(uint8_t val)
 {
-    WriteByte(val);
+    return WriteByte(val);
+}
+
+size_t SC16IS750::write(const uint8_t *buffer, size_t size)
+{
+    size_t sent = 0;
+    uint32_t start = millis();
+    while (sent < size) {
+        uint8_t length = FIFOAvailableSpace();   //wait for room in the TX FIFO
+        if (length == 0) {
+            if (millis() - start >= SC16IS750_TX_TIMEOUT) {
+                break;                           //the FIFO does not drain, return what was written
+            }
+            continue;
+        }
+        if (length > SC16IS750_BURST_LEN) {
+            length = SC16IS750_BURST_LEN;
+        }
+        if (length > size - sent) {
+            length = size - sent;
+        }
+        WriteBytes(buffer + sent, length);
+        sent += length;
+        start = millis();
+    }
+    return sent;
 }
 
 void SC16IS750::pinMode(uint8_t pin, uint8_t i_o)
@@ -362,6 +395,19 @@ uint8_t SC16IS750::InterruptPendingTest(void)
     return (ReadRegister(SC16IS750_REG_IIR) & 0x01);
 }
 
+void SC16IS750::SetReceiveRing(ELClientRing *ring)
+{
+    rx_ring = ring;
+    if (ring != NULL) {                              //RHR and receiver time-out interrupt drive the IRQ pin
+        WriteRegister(SC16IS750_REG_IER, ReadRegister(SC16IS750_REG_IER) | 0x01);
+    } else {
+        WriteRegister(SC16IS750_REG_IER, ReadRegister(SC16IS750_REG_IER) & 0xFE);
+    }
+}
+
+//Services the IRQ pin. With a receive ring set the RX FIFO is moved into the ring in bursts.
+//The Wire library cannot be used from an interrupt on AVR, with I2C call this from loop()
+//while the IRQ pin is low; with SPI it can be called from the pin interrupt.
 void SC16IS750::__isr(void)
 {
     uint8_t irq_src;
@@ -374,8 +420,20 @@ void SC16IS750::__isr(void)
         case 0x06:                  //Receiver Line Status Error
             break;
         case 0x0c:               //Receiver time-out interrupt
-            break;
         case 0x04:               //RHR interrupt
+            if (rx_ring != NULL) {
+                uint8_t buf[SC16IS750_BURST_LEN];
+                uint8_t level = FIFOAvailableData();
+                while (level > 0) {
+                    uint8_t len = level > SC16IS750_BURST_LEN ? SC16IS750_BURST_LEN : level;
+                    ReadBytes(buf, len);
+                    for (uint8_t i = 0; i < len; i++) {
+                        rx_ring->push(buf[i]);
+                    }
+                    level -= len;
+                }
+                rx_level = 0;
+            }
             break;
         case 0x02:               //THR interrupt
             break;
@@ -462,9 +520,10 @@ uint8_t SC16IS750::FIFOAvailableSpace(void)
 
 }
 
-void SC16IS750::WriteByte(uint8_t val)
+uint8_t SC16IS750::WriteByte(uint8_t val)
 {
 	uint8_t tmp_lsr;
+	uint32_t start = millis();
  /*   while ( FIFOAvailableSpace() == 0 ){
 #ifdef  SC16IS750_DEBUG_PRINT
 		Serial.println("No available space");
@@ -479,18 +538,65 @@ void SC16IS750::WriteByte(uint8_t val)
 */
 	do {
 		tmp_lsr = ReadRegister(SC16IS750_REG_LSR);
+		if ((tmp_lsr&0x20) == 0 && millis() - start >= SC16IS750_TX_TIMEOUT) {
+			return 0;          //THR never emptied, the byte is not sent
+		}
 	} while ((tmp_lsr&0x20) ==0);
 
 	WriteRegister(SC16IS750_REG_THR,val);
+	return 1;
 
 
 
 }
 
+void SC16IS750::WriteBytes(const uint8_t *buffer, uint8_t length)
+{
+	if ( protocol == SC16IS750_PROTOCOL_I2C ) {  // burst write to THR via I2C
+		WIRE.beginTransmission(device_address_sspin);
+		WIRE.write((SC16IS750_REG_THR<<3));
+		WIRE.write(buffer, length);
+		WIRE.endTransmission(1);
+	} else {
+		::digitalWrite(device_address_sspin, LOW);
+		delayMicroseconds(10);
+		SPI.transfer(SC16IS750_REG_THR<<3);
+		while (length--) {
+			SPI.transfer(*buffer++);
+		}
+		delayMicroseconds(10);
+		::digitalWrite(device_address_sspin, HIGH);
+	}
+}
+
+void SC16IS750::ReadBytes(uint8_t *buffer, uint8_t length)
+{
+	if ( protocol == SC16IS750_PROTOCOL_I2C ) {  // burst read from RHR via I2C
+		WIRE.beginTransmission(device_address_sspin);
+		WIRE.write((SC16IS750_REG_RHR<<3));
+		WIRE.endTransmission(0);
+		WIRE.requestFrom(device_address_sspin, length);
+		while (length--) {
+			*buffer++ = WIRE.read();
+		}
+	} else {
+		::digitalWrite(device_address_sspin, LOW);
+		delayMicroseconds(10);
+		SPI.transfer(0x80|(SC16IS750_REG_RHR<<3));
+		while (length--) {
+			*buffer++ = SPI.transfer(0xff);
+		}
+		delayMicroseconds(10);
+		::digitalWrite(device_address_sspin, HIGH);
+	}
+}
 int SC16IS750::ReadByte(void)
 {
 	volatile uint8_t val;
-	if (FIFOAvailableData() == 0) {
+	if (rx_level == 0) {
+		rx_level = FIFOAvailableData();
+	}
+	if (rx_level == 0) {
 #ifdef  SC16IS750_DEBUG_PRINT
 	Serial.println("No data available");
 #endif
@@ -501,6 +607,7 @@ int SC16IS750::ReadByte(void)
 #ifdef  SC16IS750_DEBUG_PRINT
 	Serial.println("***********Data available***********");
 #endif
+	  rx_level--;
 	  val = ReadRegister(SC16IS750_REG_RHR);
 	  return val;
 	}
@@ -28,6 +28,7 @@ Please keep the above information when you use this code in your project.
 #else
  #include "WProgram.h"
 #endif
+#include "ELClientRing.h"
 
 //Device Address
 
@@ -103,6 +104,10 @@ Please keep the above information when you use this code in your project.
 //#define     SC16IS750_DEBUG_PRINT   (0)
 #define     SC16IS750_PROTOCOL_I2C  (0)
 #define     SC16IS750_PROTOCOL_SPI  (1)
+#define     SC16IS750_BURST_LEN     (31)    //max bytes per FIFO burst, the Wire buffer is 32 bytes including the register address
+#ifndef SC16IS750_TX_TIMEOUT
+#define     SC16IS750_TX_TIMEOUT    (100)   //ms write waits for room in the TX FIFO before it gives up
+#endif
 
 
 
@@ -114,6 +119,8 @@ class SC16IS750 : public Stream
         void begin(uint32_t baud);                               
         int read();
         size_t write(uint8_t val);
+        size_t write(const uint8_t *buffer, size_t size);
+        using Print::write;
         int available();
         void pinMode(uint8_t pin, uint8_t io);
         void digitalWrite(uint8_t pin, uint8_t value);
@@ -129,6 +136,8 @@ class SC16IS750 : public Stream
 		void    InterruptControl(uint8_t int_ena);
 		void    ModemPin(uint8_t gpio); //gpio == 0, gpio[7:4] are modem pins, gpio == 1 gpio[7:4] are gpios
 		void    GPIOLatch(uint8_t latch);
+		void    SetReceiveRing(ELClientRing *ring);    //received bytes are moved into the ring by __isr
+		void    __isr(void);                          //call when the IRQ pin goes low
         
     
     private:
@@ -149,18 +158,21 @@ class SC16IS750 : public Stream
         
         
         
-        void    __isr(void);
         void    FIFOEnable(uint8_t fifo_enable);
         void    FIFOReset(uint8_t rx_fifo);
         void    FIFOSetTriggerLevel(uint8_t rx_fifo, uint8_t length);
         uint8_t FIFOAvailableData(void);
         uint8_t FIFOAvailableSpace(void);
-        void    WriteByte(uint8_t val);
+        uint8_t WriteByte(uint8_t val);
+        void    WriteBytes(const uint8_t *buffer, uint8_t length);
+        void    ReadBytes(uint8_t *buffer, uint8_t length);
         int     ReadByte(void);
         void    EnableTransmit(uint8_t tx_enable);
 	//	int16_t readwithtimeout();
 		int 	peek_buf;
 		uint8_t peek_flag;
+		uint8_t rx_level;   //bytes known to be in the RX FIFO, saves reading RXLVL in available() and before every RHR read
+		ELClientRing *rx_ring;  //ring filled by __isr, NULL if not used
 		
 };
 
@@ -0,0 +1,159 @@
+/**
+ * Benchmark of the El-Client protocol helpers, does not need esp-link to be connected.
+ * Prints on the debug serial port:
+ * - the throughput of each CRC engine in bytes per second. The engine used by the library
+ *   itself is selected with ELCLIENT_CRC_ENGINE in ELClient.h
+ * - the time to encode a request argument of 1 to BENCH_LEN bytes, using the original
+ *   byte-at-a-time escape and CRC loop and using ELClient::Request
+ * - the time to send a 4-byte MQTT publish with ELClientMqtt::publish and with a pre-encoded
+ *   ELClientFrameTemplate
+ */
+
+#include <ELClient.h>
+#include <ELClientMqtt.h>
+#include <ELClientFrameTemplate.h>
+
+#ifdef __AVR__
+#define BENCH_LEN  256   // size of the buffer that is checksummed and encoded
+#else
+#define BENCH_LEN  1024
+#endif
+#define BENCH_RUNS 64    // number of times each measurement is repeated
+
+// Stream that throws away everything written to it, so only the encoding is measured
+class NullStream : public Stream {
+  public:
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *, size_t size) { return size; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() {}
+};
+
+NullStream nullStream;
+ELClient esp(&nullStream);
+
+uint8_t benchBuf[BENCH_LEN];
+
+typedef uint16_t (*CrcEngine)(const unsigned char *data, uint16_t len, uint16_t acc);
+
+// Run one CRC engine over benchBuf and print its throughput
+void benchCrc(const __FlashStringHelper *name, CrcEngine engine) {
+  uint16_t crc = 0;
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < BENCH_RUNS; i++)
+    crc = engine(benchBuf, BENCH_LEN, crc);
+  uint32_t elapsed = micros() - start;
+  if (elapsed == 0) elapsed = 1;
+
+  Serial.print(name);
+  Serial.print(F(": "));
+  Serial.print((uint32_t)((uint64_t)BENCH_LEN * BENCH_RUNS * 1000000UL / elapsed));
+  Serial.print(F(" bytes/s, crc=0x"));
+  Serial.println(crc, HEX);
+}
+
+// The argument encoding as it was done before the fused kernel: one escape and one CRC
+// update per byte, each escaped byte written to the stream separately
+uint16_t legacyArg(const uint8_t *d, uint16_t len, uint16_t crc) {
+  nullStream.write((uint8_t)len);
+  nullStream.write((uint8_t)(len >> 8));
+  crc = ELClient::crc16Data((const unsigned char *)&len, 2, crc);
+  for (uint16_t l = len; l > 0; l--) {
+    if (*d == 0300 || *d == 0333) {
+      nullStream.write((uint8_t)0333);
+      nullStream.write((uint8_t)(*d == 0300 ? 0334 : 0335));
+    } else {
+      nullStream.write(*d);
+    }
+    crc = ELClient::crc16Add(*d, crc);
+    d++;
+  }
+  uint16_t pad = (4-(len&3))&3;
+  while (pad--) {
+    nullStream.write((uint8_t)0);
+    crc = ELClient::crc16Add(0, crc);
+  }
+  return crc;
+}
+
+// Time legacyArg and Request for one argument size and print both in microseconds per call
+void benchArg(uint16_t len) {
+  uint16_t crc = 0;
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < BENCH_RUNS; i++)
+    crc = legacyArg(benchBuf, len, crc);
+  uint32_t legacy = micros() - start;
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_RUNS; i++)
+    esp.Request(benchBuf, len);
+  uint32_t fused = micros() - start;
+
+  Serial.print(F("arg "));
+  Serial.print(len);
+  Serial.print(F(" bytes: legacy "));
+  Serial.print((float)legacy / BENCH_RUNS);
+  Serial.print(F(" us, fused "));
+  Serial.print((float)fused / BENCH_RUNS);
+  Serial.println(F(" us"));
+}
+
+// Time a publish of a 4-byte value to a fixed topic, built from scratch and from a template
+void benchTemplate() {
+  static const char topic[] = "/esp-link/bench/temperature";
+  ELClientMqtt mqtt(&esp);
+  uint8_t frameBuf[64];
+  ELClientFrameTemplate frame(&esp, frameBuf, sizeof(frameBuf));
+  uint16_t len = 4;
+  uint8_t qos = 0, retain = 0;
+  frame.begin(CMD_MQTT_PUBLISH, 0, 5);
+  frame.arg(topic);
+  uint8_t field = frame.field(4);
+  frame.arg(&len, 2);
+  frame.arg(&qos, 1);
+  frame.arg(&retain, 1);
+  frame.end();
+
+  uint32_t value = 0;
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < BENCH_RUNS; i++, value++)
+    mqtt.publish(topic, (const uint8_t *)&value, 4);
+  uint32_t publish = micros() - start;
+
+  start = micros();
+  for (uint16_t i = 0; i < BENCH_RUNS; i++, value++) {
+    frame.set(field, value);
+    frame.send();
+  }
+  uint32_t templ = micros() - start;
+
+  Serial.print(F("publish 4 bytes: publish "));
+  Serial.print((float)publish / BENCH_RUNS);
+  Serial.print(F(" us, template "));
+  Serial.print((float)templ / BENCH_RUNS);
+  Serial.println(F(" us"));
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("EL-Client benchmark"));
+
+  for (uint16_t i = 0; i < BENCH_LEN; i++)
+    benchBuf[i] = (uint8_t)(i * 37 + 11);
+
+  benchCrc(F("crc bitwise"), ELClient::crc16DataBitwise);
+  benchCrc(F("crc table  "), ELClient::crc16DataTable);
+  benchCrc(F("crc slice4 "), ELClient::crc16DataSlice4);
+
+  esp.Request(CMD_NULL, 0, 0);
+  for (uint16_t len = 1; len <= BENCH_LEN; len *= 4)
+    benchArg(len);
+  esp.Request();
+
+  benchTemplate();
+}
+
+void loop() {
+}
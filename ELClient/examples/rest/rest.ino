@@ -50,11 +50,11 @@ void setup() {
 
   // Get immediate wifi status info for demo purposes. This is not normally used because the
   // wifi status callback registered above gets called immediately. 
-  esp.GetWifiStatus();
-  ELClientPacket *packet;
-  if ((packet=esp.WaitReturn()) != NULL) {
+  ELClientFuture<uint8_t> status = esp.GetWifiStatus();
+  status.wait();
+  if (status.ok()) {
     Serial.print("Wifi status: ");
-    Serial.println(packet->value);
+    Serial.println(status.value());
   }
 
   // Set up the REST client to talk to www.timeapi.org, this doesn't connect to that server,
@@ -143,12 +143,12 @@ void setup() {
 	Serial.println(F("EL-Client synced!"));
 
 	// Wit for WiFi to be connected. 
-	esp.GetWifiStatus();
-	ELClientPacket *packet;
+	ELClientFuture<uint8_t> status = esp.GetWifiStatus();
 	Serial.print(F("Waiting for WiFi "));
-	if ((packet=esp.WaitReturn()) != NULL) {
+	status.wait();
+	if (status.ok()) {
 		Serial.print(F("."));
-		Serial.println(packet->value);
+		Serial.println(status.value());
 	}
 	Serial.println("");
 
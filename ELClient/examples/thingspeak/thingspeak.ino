@@ -76,12 +76,12 @@ void setup() {
 
 	// Wait for WiFi to be connected. 
 Serial.println("esp.GetWifiStatus()");
-	esp.GetWifiStatus();
-	ELClientPacket *packet;
+	ELClientFuture<uint8_t> status = esp.GetWifiStatus();
 	Serial.println("Waiting for WiFi ");
-	if ((packet=esp.WaitReturn()) != NULL) {
+	status.wait();
+	if (status.ok()) {
 		Serial.print(".");
-		Serial.println(packet->value);
+		Serial.println(status.value());
 	}
 	Serial.println("");
 
@@ -136,11 +136,11 @@ void setup() {
 
 	// Get immediate wifi status info for demo purposes. This is not normally used because the
 	// wifi status callback registered above gets called immediately.
-	esp.GetWifiStatus();
-	ELClientPacket *packet;
-	if ((packet=esp.WaitReturn()) != NULL) {
+	ELClientFuture<uint8_t> status = esp.GetWifiStatus();
+	status.wait();
+	if (status.ok()) {
 		Serial.print(F("Wifi status: "));
-		Serial.println(packet->value);
+		Serial.println(status.value());
 	}
 
 	// Set up the UDP socket client to send a short message to <udpServer> on port <>, this doesn't connect to that server,
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Decode the binary trace written by ELClient::DumpTrace.
+
+Capture the serial output to a file, e.g.
+    cat /dev/ttyUSB0 > capture.bin   (or the log of any terminal program)
+then run
+    python3 eltrace.py capture.bin
+Text printed around the dump is skipped, every "ELTR" block in the file is decoded.
+"""
+
+import struct
+import sys
+
+MAGIC = b"ELTR"
+HEADER = struct.Struct("<4sBBBB")   # magic, version, record size, count, reserved
+RECORD = struct.Struct("<IBBHH")    # time, event, flags, cmd, len
+
+EVENTS = {
+    1: "RX", 2: "TX", 3: "RUNT", 4: "OVERFLOW",
+    5: "TIMEOUT", 6: "SYNC", 7: "RESET", 8: "APP",
+}
+
+COMMANDS = {
+    0: "NULL", 1: "SYNC", 2: "RESP_V", 3: "RESP_CB", 4: "WIFI_STATUS",
+    5: "CB_ADD", 6: "CB_EVENTS", 7: "GET_TIME",
+    10: "MQTT_SETUP", 11: "MQTT_PUBLISH", 12: "MQTT_SUBSCRIBE", 13: "MQTT_LWT",
+    15: "MQTT_TOPIC", 16: "MQTT_PUBLISH_ID",
+    20: "REST_SETUP", 21: "REST_REQUEST", 22: "REST_SETHEADER",
+    30: "WEB_DATA", 31: "WEB_REQ_CB",
+    40: "SOCKET_SETUP", 41: "SOCKET_SEND",
+}
+
+
+def describe(event, flags, cmd, length):
+    name = EVENTS.get(event, "EVENT%d" % event)
+    cmd_name = COMMANDS.get(cmd, str(cmd))
+    if event == 1:
+        return "%-8s %-14s len=%-4d %s" % (name, cmd_name, length,
+                                            "crc ok" if flags & 1 else "CRC ERROR")
+    if event == 2:
+        return "%-8s %-14s len=%d" % (name, cmd_name, length)
+    if event in (3, 4):
+        return "%-8s len=%d" % (name, length)
+    if event == 5:
+        return "%-8s token=%d" % (name, length)
+    if event == 6:
+        return "%-8s epoch=%d" % (name, length)
+    if event == 8:
+        return "%-8s %-14s flags=0x%02x value=%d" % (name, cmd_name, flags, length)
+    return name
+
+
+def decode(data, out=sys.stdout):
+    pos = data.find(MAGIC)
+    dumps = 0
+    while pos >= 0 and pos + HEADER.size <= len(data):
+        _, version, size, count, _ = HEADER.unpack_from(data, pos)
+        body = pos + HEADER.size
+        if version != 1 or size < RECORD.size or body + count * size > len(data):
+            pos = data.find(MAGIC, pos + 1)
+            continue
+        dumps += 1
+        out.write("trace %d: %d records\n" % (dumps, count))
+        first = prev = None
+        for i in range(count):
+            time, event, flags, cmd, length = RECORD.unpack_from(data, body + i * size)
+            if first is None:
+                first = prev = time
+            # micros() wraps after about 71 minutes, the mask keeps the deltas right
+            out.write("%10d us %+9d  %s\n" % ((time - first) & 0xffffffff,
+                                              (time - prev) & 0xffffffff,
+                                              describe(event, flags, cmd, length)))
+            prev = time
+        pos = data.find(MAGIC, body + count * size)
+    return dumps
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: %s <capture file | ->\n" % sys.argv[0])
+        return 2
+    if sys.argv[1] == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(sys.argv[1], "rb") as f:
+            data = f.read()
+    if decode(data) == 0:
+        sys.stderr.write("no trace found\n")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
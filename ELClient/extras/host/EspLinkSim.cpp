@@ -0,0 +1,718 @@
+/*! \file EspLinkSim.cpp
+    \brief Constructor and functions for EspLinkSim
+    \note In-process stand-in for esp-link, used by the host build
+*/
+
+#include "EspLinkSim.h"
+#include <ELClient.h>
+#include <ELClientSocket.h>
+#include <chrono>
+#include <time.h>
+
+#define SLIP_END  0300        /**< Indicates end of packet */
+#define SLIP_ESC  0333        /**< Indicates byte stuffing */
+#define SLIP_ESC_END  0334    /**< ESC ESC_END means END data byte */
+#define SLIP_ESC_ESC  0335    /**< ESC ESC_ESC means ESC data byte */
+
+#define SIM_REST_CLIENTS 4    /**< esp-link supports 4 REST connections */
+#define SIM_SOCKETS 4         /**< esp-link supports 4 socket connections */
+
+enum {
+  MQTT_CB_CONNECTED = 0,
+  MQTT_CB_DISCONNECTED,
+  MQTT_CB_PUBLISHED,
+  MQTT_CB_DATA
+};
+
+// Argument holding the bytes of a value, as esp-link sends numbers
+template<typename T>
+static EspLinkArg valueArg(T v) { return EspLinkArg((const char*)&v, sizeof(v)); }
+
+// Value of a numeric argument, missing bytes read as 0
+static uint32_t argValue(const EspLinkArg& arg) {
+  uint32_t v = 0;
+  memcpy(&v, arg.data(), arg.size() < sizeof(v) ? arg.size() : sizeof(v));
+  return v;
+}
+
+/*! EspLinkSim()
+@brief Constructor for EspLinkSim
+@details The link starts without delays, with wifi connected and the MQTT broker connected
+@par Example
+@code
+	EspLinkSim sim;
+	ELClient esp(&sim);
+	esp.Sync();
+@endcode
+*/
+EspLinkSim::EspLinkSim() :
+  _inFrame(false), _esc(false), _rxLineFree(0), _lineFree(0), _when(0), _byteTime(0), _latency(0),
+  _wifiCb(0), _wifiStatus(STATION_GOT_IP), _mqttConnected(true), _webResponses(0), _syncs(0) {
+  memset(_mqttCb, 0, sizeof(_mqttCb));
+  memset(&_stats, 0, sizeof(_stats));
+  _http = [](const std::string& method, const std::string& path, const std::string& body,
+             std::string& response) -> uint16_t {
+    response = method + " " + path;
+    if (!body.empty()) response += "\n" + body;
+    return 200;
+  };
+}
+
+/*! setBaud(uint32_t baud)
+@brief Pace the link like a serial line
+@details Bytes written by the library arrive one byte time apart, response bytes only become
+	available to read() once their byte time has passed. Writes never block.
+@param baud
+	Baud rate, 10 bits per byte; 0 removes the pacing
+*/
+void EspLinkSim::setBaud(uint32_t baud) {
+  _byteTime = baud ? (10000000UL + baud - 1) / baud : 0;
+}
+
+/*! now(void)
+@brief Time base of the link model
+@note Internal function
+@return <code>uint64_t</code>
+	Microseconds on the steady clock
+*/
+uint64_t EspLinkSim::now(void) const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*! available(void)
+@brief Number of response bytes that have arrived
+@return <code>int</code>
+	Bytes that can be read without waiting
+*/
+int EspLinkSim::available(void) {
+  if (_byteTime == 0 && _latency == 0) return _out.size();
+  uint64_t t = now();
+  int n = 0;
+  for (auto it = _out.begin(); it != _out.end() && it->second <= t; ++it) n++;
+  return n;
+}
+
+/*! read(void)
+@brief Read one response byte
+@return <code>int</code>
+	The byte or -1 if none has arrived
+*/
+int EspLinkSim::read(void) {
+  int c = peek();
+  if (c >= 0) {
+    _out.pop_front();
+    _stats.bytesOut++;
+  }
+  return c;
+}
+
+/*! peek(void)
+@brief Look at the next response byte
+@return <code>int</code>
+	The byte or -1 if none has arrived
+*/
+int EspLinkSim::peek(void) {
+  if (_out.empty() || (_out.front().second && _out.front().second > now())) return -1;
+  return _out.front().first;
+}
+
+/*! write(uint8_t c)
+@brief Receive one byte from the library
+@param c
+	The byte
+@return <code>size_t</code>
+	Always 1
+*/
+size_t EspLinkSim::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+/*! write(const uint8_t* buf, size_t size)
+@brief Receive bytes from the library
+@details Frames are SLIP decoded as they come in and handled when their SLIP_END arrives.
+	The bytes between frames are ignored, like esp-link does.
+@param buf
+	Pointer to the bytes
+@param size
+	Number of bytes
+@return <code>size_t</code>
+	Always size
+*/
+size_t EspLinkSim::write(const uint8_t* buf, size_t size) {
+  _stats.bytesIn += size;
+  if (_byteTime) {
+    uint64_t t = now();
+    if (_rxLineFree < t) _rxLineFree = t;
+  }
+  for (size_t i = 0; i < size; i++) {
+    uint8_t c = buf[i];
+    _rxLineFree += _byteTime;
+    if (c == SLIP_END) {
+      if (_inFrame && !_frame.empty()) frameEnd();
+      _frame.clear();
+      _inFrame = true;
+      _esc = false;
+    } else if (!_inFrame) {
+      continue;
+    } else if (_esc) {
+      _frame.push_back(c == SLIP_ESC_END ? SLIP_END : c == SLIP_ESC_ESC ? SLIP_ESC : c);
+      _esc = false;
+    } else if (c == SLIP_ESC) {
+      _esc = true;
+    } else {
+      _frame.push_back(c);
+    }
+  }
+  return size;
+}
+
+/*! frameEnd(void)
+@brief Check a received frame and split it into its arguments
+@note Internal function
+*/
+void EspLinkSim::frameEnd(void) {
+  if (_frame.size() < 10) {
+    _stats.malformed++;
+    return;
+  }
+  size_t len = _frame.size() - 2;
+  uint16_t crc = _frame[len] | (_frame[len + 1] << 8);
+  if (crc16(_frame.data(), len) != crc) {
+    _stats.crcErrors++;
+    return;
+  }
+
+  ELClientPacket hdr;
+  memcpy(&hdr, _frame.data(), sizeof(hdr));
+  std::vector<EspLinkArg> args;
+  size_t pos = sizeof(hdr);
+  for (uint16_t i = 0; i < hdr.argc; i++) {
+    // CMD_WEB_DATA announces 255 arguments and ends early
+    if (pos == len && hdr.argc == 255) break;
+    if (pos + 2 > len) {
+      _stats.malformed++;
+      return;
+    }
+    uint16_t argLen = _frame[pos] | (_frame[pos + 1] << 8);
+    pos += 2;
+    if (pos + argLen > len) {
+      _stats.malformed++;
+      return;
+    }
+    args.push_back(EspLinkArg((const char*)&_frame[pos], argLen));
+    pos += argLen + ((4 - (argLen & 3)) & 3);   // requests pad the data only
+  }
+
+  _stats.framesIn++;
+  // the answers start after the request has arrived and esp-link has worked on it
+  _when = (_byteTime ? _rxLineFree : now()) + _latency;
+  dispatch(hdr.cmd, hdr.value, args);
+  _when = 0;
+}
+
+/*! dispatch(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args)
+@brief Carry out a request the way esp-link does
+@note Internal function
+@param cmd
+	Command of the request
+@param value
+	Value of the request
+@param args
+	Arguments of the request
+*/
+void EspLinkSim::dispatch(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args) {
+  if (_handler && _handler(cmd, value, args)) return;
+  switch (cmd) {
+    case CMD_SYNC:
+      // esp-link drops all callbacks, the library registers them again
+      _syncs++;
+      _wifiCb = value;
+      _customCb.clear();
+      memset(_mqttCb, 0, sizeof(_mqttCb));
+      _subs.clear();
+      _aliases.clear();
+      respond(CMD_RESP_V, value, std::vector<EspLinkArg>());
+      respond(CMD_RESP_CB, _wifiCb, std::vector<EspLinkArg>(1, valueArg(_wifiStatus)));
+      break;
+
+    case CMD_WIFI_STATUS:
+      respond(CMD_RESP_V, _wifiStatus, std::vector<EspLinkArg>());
+      break;
+
+    case CMD_CB_ADD:
+      if (args.size() >= 1) _customCb[args[0]] = value;
+      break;
+
+    case CMD_GET_TIME:
+      respond(CMD_RESP_V, (uint32_t)time(NULL), std::vector<EspLinkArg>());
+      break;
+
+    case CMD_MQTT_SETUP:
+      if (args.size() < 4) {
+        _stats.malformed++;
+        break;
+      }
+      for (int i = 0; i < 4; i++) _mqttCb[i] = argValue(args[i]);
+      if (_mqttConnected && _mqttCb[MQTT_CB_CONNECTED])
+        respond(CMD_RESP_CB, _mqttCb[MQTT_CB_CONNECTED], std::vector<EspLinkArg>());
+      break;
+
+    case CMD_MQTT_PUBLISH: {
+      if (args.size() < 5) {
+        _stats.malformed++;
+        break;
+      }
+      if (!_mqttConnected) {
+        _stats.mqttLost++;
+        break;
+      }
+      // the length argument is authoritative, the data argument may be a longer buffer
+      std::string data = args[1].substr(0, argValue(args[2]) & 0xFFFF);
+      mqttPublish(args[0], data, argValue(args[4]) != 0);
+      if (argValue(args[3]) > 0 && _mqttCb[MQTT_CB_PUBLISHED])
+        respond(CMD_RESP_CB, _mqttCb[MQTT_CB_PUBLISHED], std::vector<EspLinkArg>());
+      break;
+    }
+
+    case CMD_MQTT_SUBSCRIBE: {
+      if (args.size() < 1) {
+        _stats.malformed++;
+        break;
+      }
+      Subscription s = { args[0], (uint8_t)(args.size() > 1 ? argValue(args[1]) : 0) };
+      _subs.push_back(s);
+      for (auto& r : _retained)
+        if (topicMatch(s.topic, r.first)) mqttDeliver(r.first, r.second);
+      break;
+    }
+
+    case CMD_MQTT_TOPIC:
+      if (args.size() < 1) {
+        _stats.malformed++;
+        break;
+      }
+      _aliases[value & 0xFF] = args[0];
+      break;
+
+    case CMD_MQTT_PUBLISH_ID: {
+      // value: id in bits 0-7, qos in bits 8-9, retain in bit 10
+      auto alias = _aliases.find(value & 0xFF);
+      if (alias == _aliases.end() || args.size() < 1) {
+        _stats.malformed++;
+        break;
+      }
+      if (!_mqttConnected) {
+        _stats.mqttLost++;
+        break;
+      }
+      mqttPublish(alias->second, args[0], (value >> 10) & 1);
+      if (((value >> 8) & 3) > 0 && _mqttCb[MQTT_CB_PUBLISHED])
+        respond(CMD_RESP_CB, _mqttCb[MQTT_CB_PUBLISHED], std::vector<EspLinkArg>());
+      break;
+    }
+
+    case CMD_MQTT_LWT:
+      if (args.size() >= 1) _lwtTopic = args[0];
+      break;
+
+    case CMD_REST_SETUP: {
+      if (args.size() < 2 || _rest.size() == SIM_REST_CLIENTS) {
+        respond(CMD_RESP_V, (uint32_t)-1, std::vector<EspLinkArg>());
+        break;
+      }
+      RestClient r;
+      r.cb = value;
+      r.host = args[0];
+      r.port = argValue(args[1]);
+      _rest.push_back(r);
+      respond(CMD_RESP_V, _rest.size() - 1, std::vector<EspLinkArg>());
+      break;
+    }
+
+    case CMD_REST_REQUEST: {
+      if (value >= _rest.size() || args.size() < 2) {
+        _stats.malformed++;
+        break;
+      }
+      std::string body;
+      uint32_t code = _http(args[0], args[1], args.size() > 2 ? args[2] : std::string(), body);
+      std::vector<EspLinkArg> resp;
+      resp.push_back(valueArg(code));
+      resp.push_back(body);
+      respond(CMD_RESP_CB, _rest[value].cb, resp);
+      break;
+    }
+
+    case CMD_REST_SETHEADER: {
+      if (value >= _rest.size() || args.size() < 2) {
+        _stats.malformed++;
+        break;
+      }
+      uint8_t index = argValue(args[0]);
+      if (index < 3) _rest[value].header[index] = args[1];
+      break;
+    }
+
+    case CMD_SOCKET_SETUP: {
+      if (args.size() < 3 || _sockets.size() == SIM_SOCKETS) {
+        respond(CMD_RESP_V, (uint32_t)-1, std::vector<EspLinkArg>());
+        break;
+      }
+      Socket s;
+      s.cb = value;
+      s.host = args[0];
+      s.port = argValue(args[1]);
+      s.mode = argValue(args[2]);
+      _sockets.push_back(s);
+      respond(CMD_RESP_V, _sockets.size() - 1, std::vector<EspLinkArg>());
+      break;
+    }
+
+    case CMD_SOCKET_SEND: {
+      if (value >= _sockets.size() || args.empty()) {
+        _stats.malformed++;
+        break;
+      }
+      // ELClientSocket::send puts the data in the last argument
+      const Socket& s = _sockets[value];
+      const std::string& data = args.back();
+      socketCb(s, USERCB_SENT, data);
+      if (s.mode == SOCKET_TCP_CLIENT_LISTEN || s.mode == SOCKET_UDP)
+        socketCb(s, USERCB_RECV, data);
+      break;
+    }
+
+    case CMD_WEB_DATA:
+      webData(args);
+      break;
+
+    default:
+      _stats.unknown++;
+      break;
+  }
+}
+
+/*! respond(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args)
+@brief Queue a frame for the library
+@note Internal function
+@param cmd
+	Command of the frame
+@param value
+	Value of the frame
+@param args
+	Arguments of the frame
+*/
+void EspLinkSim::respond(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args) {
+  _stats.framesOut++;
+  injectBytes(encode(cmd, value, args));
+}
+
+/*! encode(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args)
+@brief Build a frame the way esp-link does it
+@details The arguments are padded including their length, then the CRC follows and everything
+	is SLIP encoded between two SLIP_END.
+@param cmd
+	Command of the frame
+@param value
+	Value of the frame
+@param args
+	Arguments of the frame
+@return <code>std::string</code>
+	The bytes on the wire
+*/
+std::string EspLinkSim::encode(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args) {
+  std::vector<uint8_t> frame(sizeof(ELClientPacket));
+  ELClientPacket hdr;
+  hdr.cmd = cmd;
+  hdr.argc = args.size();
+  hdr.value = value;
+  memcpy(frame.data(), &hdr, sizeof(hdr));
+  for (const EspLinkArg& arg : args) {
+    uint16_t len = arg.size();
+    frame.push_back(len & 0xFF);
+    frame.push_back(len >> 8);
+    frame.insert(frame.end(), arg.begin(), arg.end());
+    frame.insert(frame.end(), (4 - ((len + 2) & 3)) & 3, 0);
+  }
+  uint16_t crc = crc16(frame.data(), frame.size());
+  frame.push_back(crc & 0xFF);
+  frame.push_back(crc >> 8);
+
+  std::string slip(1, (char)SLIP_END);
+  for (uint8_t c : frame) {
+    if (c == SLIP_END || c == SLIP_ESC) {
+      slip += (char)SLIP_ESC;
+      c = c == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+    }
+    slip += (char)c;
+  }
+  slip += (char)SLIP_END;
+  return slip;
+}
+
+/*! injectBytes(const std::string& bytes)
+@brief Queue raw bytes for the library
+@details Without pacing the bytes can be read right away, otherwise they follow the bytes that
+	are still on the line
+@param bytes
+	The bytes
+*/
+void EspLinkSim::injectBytes(const std::string& bytes) {
+  if (_byteTime == 0 && _latency == 0) {
+    for (char c : bytes) _out.push_back(std::make_pair((uint8_t)c, (uint64_t)0));
+    return;
+  }
+  uint64_t t = _when ? _when : now() + _latency;
+  if (t < _lineFree) t = _lineFree;
+  for (char c : bytes) {
+    t += _byteTime;
+    _out.push_back(std::make_pair((uint8_t)c, t));
+  }
+  _lineFree = t;
+}
+
+/*! inject(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args)
+@brief Send a frame to the library
+@param cmd
+	Command of the frame
+@param value
+	Value of the frame
+@param args
+	Arguments of the frame
+@par Example
+@code
+	// a callback with a handle the library never handed out
+	sim.inject(CMD_RESP_CB, ELC_HANDLE_BASE + 42, std::vector<EspLinkArg>());
+@endcode
+*/
+void EspLinkSim::inject(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args) {
+  respond(cmd, value, args);
+}
+
+/*! setMqttConnected(bool connected)
+@brief Connect or disconnect the broker
+@param connected
+	New state, a change is sent to the connected or disconnected callback of the library
+*/
+void EspLinkSim::setMqttConnected(bool connected) {
+  if (connected == _mqttConnected) return;
+  _mqttConnected = connected;
+  uint32_t cb = _mqttCb[connected ? MQTT_CB_CONNECTED : MQTT_CB_DISCONNECTED];
+  if (cb) respond(CMD_RESP_CB, cb, std::vector<EspLinkArg>());
+}
+
+/*! mqttPublish(const std::string& topic, const std::string& data, bool retain)
+@brief Publish a message on the loopback broker
+@param topic
+	Topic of the message
+@param data
+	Content of the message
+@param retain
+	Keep the message for later subscriptions, an empty retained message removes it
+*/
+void EspLinkSim::mqttPublish(const std::string& topic, const std::string& data, bool retain) {
+  if (retain) {
+    if (data.empty()) _retained.erase(topic);
+    else _retained[topic] = data;
+  }
+  if (!_mqttConnected) return;
+  for (const Subscription& s : _subs) {
+    if (topicMatch(s.topic, topic)) {
+      mqttDeliver(topic, data);
+      break;   // one delivery per client, even if several subscriptions match
+    }
+  }
+}
+
+/*! mqttDeliver(const std::string& topic, const std::string& data)
+@brief Send a message to the MQTT data callback
+@note Internal function
+*/
+void EspLinkSim::mqttDeliver(const std::string& topic, const std::string& data) {
+  if (!_mqttCb[MQTT_CB_DATA]) return;
+  std::vector<EspLinkArg> args;
+  args.push_back(topic);
+  args.push_back(data);
+  respond(CMD_RESP_CB, _mqttCb[MQTT_CB_DATA], args);
+}
+
+/*! topicMatch(const std::string& filter, const std::string& topic)
+@brief MQTT topic filter matching
+@details + matches one level, # matches the remaining levels including none
+@note Internal function
+@return <code>bool</code>
+	True if the topic matches the filter
+*/
+bool EspLinkSim::topicMatch(const std::string& filter, const std::string& topic) {
+  size_t f = 0, t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') t++;
+      f++;
+      continue;
+    }
+    if (t >= topic.size()) {
+      // "a/#" also matches "a"
+      return filter.compare(f, std::string::npos, "/#") == 0;
+    }
+    if (filter[f] != topic[t]) return false;
+    f++;
+    t++;
+  }
+  return t == topic.size();
+}
+
+/*! socketCb(const Socket& s, uint8_t type, const std::string& data)
+@brief Send a socket event to the socket callback
+@note Internal function
+*/
+void EspLinkSim::socketCb(const Socket& s, uint8_t type, const std::string& data) {
+  std::vector<EspLinkArg> args;
+  args.push_back(valueArg(type));
+  args.push_back(valueArg((uint8_t)0));   // client number
+  args.push_back(valueArg((uint16_t)data.size()));
+  if (type == USERCB_RECV) args.push_back(data);
+  respond(CMD_RESP_CB, s.cb, args);
+}
+
+/*! socketReceive(uint8_t instance, const std::string& data)
+@brief Data sent by the remote end of a socket connection
+@param instance
+	Connection number returned to ELClientSocket::begin
+@param data
+	The data
+@return <code>bool</code>
+	False if there is no such connection
+*/
+bool EspLinkSim::socketReceive(uint8_t instance, const std::string& data) {
+  if (instance >= _sockets.size()) return false;
+  socketCb(_sockets[instance], USERCB_RECV, data);
+  return true;
+}
+
+/*! webRequest(uint8_t reason, const std::string& url, const std::vector<std::pair<std::string, std::string> >& fields)
+@brief Browser request to the web server
+@details Sent to the "webCb" custom callback, nothing is sent if the library did not register it
+@param reason
+	0 page load, 1 refresh, 2 button press, 3 form submit
+@param url
+	URL of the page
+@param fields
+	Button id (as the name of the only entry) or form fields
+@return <code>bool</code>
+	False if the web server callback is not registered
+@par Example
+@code
+	sim.webRequest(3, "/LED.html.json", { { "led_state", "on" } });
+@endcode
+*/
+bool EspLinkSim::webRequest(uint8_t reason, const std::string& url,
+                            const std::vector<std::pair<std::string, std::string> >& fields) {
+  auto cb = _customCb.find("webCb");
+  if (cb == _customCb.end()) return false;
+
+  static const uint8_t ip[4] = { 127, 0, 0, 1 };
+  std::vector<EspLinkArg> args;
+  args.push_back(valueArg((uint16_t)reason));
+  args.push_back(EspLinkArg((const char*)ip, 4));
+  args.push_back(valueArg((uint16_t)80));
+  args.push_back(url);
+  for (const auto& f : fields) {
+    if (reason == 2) {
+      args.push_back(f.first);
+      break;
+    }
+    // form fields are sent as strings: type, name, 0, value
+    args.push_back(std::string(1, '\0') + f.first + std::string(1, '\0') + f.second);
+  }
+  respond(CMD_WEB_REQ_CB, cb->second, args);
+  return true;
+}
+
+/*! webData(const std::vector<EspLinkArg>& args)
+@brief Collect the fields of a CMD_WEB_DATA answer
+@details The arguments are the IP address and port of the browser, then one field each: type,
+	name, 0, value
+@note Internal function
+*/
+void EspLinkSim::webData(const std::vector<EspLinkArg>& args) {
+  _webResponses++;
+  _webFields.clear();
+  for (size_t i = 2; i < args.size(); i++) {
+    const EspLinkArg& a = args[i];
+    if (a.empty()) break;
+    size_t nul = a.find('\0', 1);
+    if (nul == std::string::npos) {
+      _stats.malformed++;
+      continue;
+    }
+    std::string name = a.substr(1, nul - 1);
+    std::string value = a.substr(nul + 1);
+    switch (a[0]) {
+      case 1:   // null
+        value = "null";
+        break;
+      case 2:   // integer
+        value = std::to_string((int32_t)argValue(value));
+        break;
+      case 3:   // boolean
+        value = value.size() && value[0] ? "true" : "false";
+        break;
+      case 4: { // float
+        float f = 0;
+        memcpy(&f, value.data(), value.size() < sizeof(f) ? value.size() : sizeof(f));
+        value = std::to_string(f);
+        break;
+      }
+      default:  // string, json
+        break;
+    }
+    _webFields[name] = value;
+  }
+}
+
+/*! topicAlias(uint8_t id)
+@brief Topic registered for an alias
+@param id
+	Alias id
+@return <code>std::string</code>
+	The topic, empty if the id is not registered
+*/
+std::string EspLinkSim::topicAlias(uint8_t id) const {
+  auto alias = _aliases.find(id);
+  return alias == _aliases.end() ? std::string() : alias->second;
+}
+
+/*! restHeader(uint8_t instance, uint8_t index)
+@brief Header set with CMD_REST_SETHEADER
+@param instance
+	REST connection number
+@param index
+	0 generic, 1 content type, 2 user agent
+@return <code>const std::string&</code>
+	The header, empty if it was not set
+*/
+const std::string& EspLinkSim::restHeader(uint8_t instance, uint8_t index) const {
+  static const std::string none;
+  if (instance >= _rest.size() || index >= 3) return none;
+  return _rest[instance].header[index];
+}
+
+/*! crc16(const uint8_t* data, size_t len)
+@brief CRC of a frame, computed the way esp-link does it
+@details Kept separate from the library's CRC engines so the simulator checks them
+@note Internal function
+*/
+uint16_t EspLinkSim::crc16(const uint8_t* data, size_t len) {
+  uint16_t acc = 0;
+  while (len--) {
+    acc ^= *data++;
+    acc = (acc >> 8) | (acc << 8);
+    acc ^= (acc & 0xff00) << 4;
+    acc ^= (acc >> 8) >> 4;
+    acc ^= (acc & 0xff00) >> 5;
+  }
+  return acc;
+}
@@ -0,0 +1,178 @@
+/*! \file EspLinkSim.h
+    \brief Definitions for EspLinkSim
+    \note In-process stand-in for esp-link, used by the host build
+*/
+
+#ifndef _ESP_LINK_SIM_H_
+#define _ESP_LINK_SIM_H_
+
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Counters of the simulator side of the link
+struct EspLinkSimStats {
+  uint32_t framesIn;   /**< Frames received from the library with a good CRC */
+  uint32_t framesOut;  /**< Frames sent to the library */
+  uint32_t bytesIn;    /**< Bytes written by the library */
+  uint32_t bytesOut;   /**< Bytes read by the library */
+  uint32_t crcErrors;  /**< Frames received with a bad CRC */
+  uint32_t malformed;  /**< Frames too short or with arguments running past their end */
+  uint32_t unknown;    /**< Frames with a command the simulator does not implement */
+  uint32_t mqttLost;   /**< Publishes dropped because the broker was not connected */
+};
+
+// One argument of a request or a response, kept as raw bytes
+typedef std::string EspLinkArg;
+
+// Stand-in for esp-link that the library talks to through its Stream interface. Bytes written by
+// the library are SLIP decoded, checked and answered the way esp-link answers them. The answers
+// are queued and handed out by read(), optionally paced by a baud rate and a processing delay so
+// the timing looks like a real serial link.
+//
+// The services behind esp-link are replaced by local stand-ins:
+// - MQTT: a loopback broker, every publish is delivered to the matching subscriptions (with +
+//   and # wildcards) and retained messages are kept per topic; topic aliases are supported
+// - REST: an HTTP responder, by default it answers 200 and echoes the method, path and body
+// - sockets: an echo peer for TCP client connections that wait for a response and for UDP,
+//   other connections only report that the data was sent; inbound data is injected with
+//   socketReceive()
+// - web server: browser requests are injected with webRequest(), the CMD_WEB_DATA answers are
+//   collected in webFields()
+class EspLinkSim : public Stream {
+  public:
+    // HTTP responder: gets the method, path and body of a request, fills in the response body
+    // and returns the status code
+    typedef std::function<uint16_t(const std::string& method, const std::string& path,
+                                   const std::string& body, std::string& response)> HttpHandler;
+    // Handler of a request, called before the built-in commands; it answers with reply() and
+    // returns true, or returns false to leave the request to the simulator
+    typedef std::function<bool(uint16_t cmd, uint32_t value,
+                               const std::vector<EspLinkArg>& args)> CommandHandler;
+
+    EspLinkSim();
+
+    //== Link model
+    // Time one byte takes on the wire, from the baud rate with 10 bits per byte, 0 = no delay
+    void setBaud(uint32_t baud);
+    // Time esp-link takes before it starts to answer a request, in microseconds
+    void setLatency(uint32_t us) { _latency = us; }
+    // Wifi status reported after CMD_SYNC and by CMD_WIFI_STATUS
+    void setWifiStatus(uint8_t status) { _wifiStatus = status; }
+    // Whether the MQTT broker counts as connected. A change is reported to the connected or
+    // disconnected callback; publishes from the library are dropped while it is not connected.
+    void setMqttConnected(bool connected);
+    // Replace the HTTP responder
+    void setHttpHandler(HttpHandler handler) { _http = handler; }
+    // Add commands or replace built-in ones
+    void setCommandHandler(CommandHandler handler) { _handler = handler; }
+    // Answer the request being handled by the command handler
+    void reply(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args) { respond(cmd, value, args); }
+
+    //== Injection, as if it came from the network side
+    // Publish a message on the loopback broker
+    void mqttPublish(const std::string& topic, const std::string& data, bool retain = false);
+    // Data received by a socket connection, instance as returned to ELClientSocket::begin
+    bool socketReceive(uint8_t instance, const std::string& data);
+    // Browser request to the web server (reason 0 load, 1 refresh, 2 button, 3 submit). For a
+    // button press fields holds one entry whose name is the button id, for a submit it holds the
+    // form fields.
+    bool webRequest(uint8_t reason, const std::string& url,
+                    const std::vector<std::pair<std::string, std::string> >& fields =
+                      std::vector<std::pair<std::string, std::string> >());
+    // Send a raw frame, for tests of the receive path
+    void inject(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args);
+    // Send raw bytes, e.g. a boot message at the wrong baud rate
+    void injectBytes(const std::string& bytes);
+    // SLIP encoded frame as esp-link sends it, with the CRC and the leading and trailing SLIP_END
+    static std::string encode(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args);
+
+    //== Inspection
+    const EspLinkSimStats& stats(void) const { return _stats; }
+    void resetStats(void) { memset(&_stats, 0, sizeof(_stats)); }
+    // Number of CMD_SYNC requests answered
+    uint32_t syncs(void) const { return _syncs; }
+    // Fields of the last CMD_WEB_DATA, by name
+    const std::map<std::string, std::string>& webFields(void) const { return _webFields; }
+    // Number of CMD_WEB_DATA frames received
+    uint32_t webResponses(void) const { return _webResponses; }
+    // Topic registered for an alias id with CMD_MQTT_TOPIC, empty if none
+    std::string topicAlias(uint8_t id) const;
+    // Last will registered with CMD_MQTT_LWT
+    const std::string& lwtTopic(void) const { return _lwtTopic; }
+    // Headers set on a REST connection, index 0 generic, 1 content type, 2 user agent
+    const std::string& restHeader(uint8_t instance, uint8_t index) const;
+    // Number of response bytes not yet read by the library
+    size_t queued(void) const { return _out.size(); }
+
+    //== Stream, used by the library
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buf, size_t size);
+    using Print::write;
+
+  private:
+    struct Subscription {
+      std::string topic;
+      uint8_t qos;
+    };
+    struct RestClient {
+      uint32_t cb;
+      std::string host;
+      uint16_t port;
+      std::string header[3];
+    };
+    struct Socket {
+      uint32_t cb;
+      std::string host;
+      uint16_t port;
+      uint8_t mode;
+    };
+
+    // receiver
+    std::vector<uint8_t> _frame;
+    bool _inFrame;
+    bool _esc;
+    uint64_t _rxLineFree;
+    // transmitter, each byte with the time it arrives at the library
+    std::deque<std::pair<uint8_t, uint64_t> > _out;
+    uint64_t _lineFree;
+    uint64_t _when;
+    uint32_t _byteTime;
+    uint32_t _latency;
+    // esp-link state
+    uint32_t _wifiCb;
+    uint8_t _wifiStatus;
+    std::map<std::string, uint32_t> _customCb;
+    uint32_t _mqttCb[4];
+    bool _mqttConnected;
+    std::vector<Subscription> _subs;
+    std::map<std::string, std::string> _retained;
+    std::string _lwtTopic;
+    std::map<uint8_t, std::string> _aliases;
+    std::vector<RestClient> _rest;
+    std::vector<Socket> _sockets;
+    HttpHandler _http;
+    CommandHandler _handler;
+    std::map<std::string, std::string> _webFields;
+    uint32_t _webResponses;
+    uint32_t _syncs;
+    EspLinkSimStats _stats;
+
+    uint64_t now(void) const;
+    void frameEnd(void);
+    void dispatch(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args);
+    void respond(uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args);
+    void mqttDeliver(const std::string& topic, const std::string& data);
+    void socketCb(const Socket& s, uint8_t type, const std::string& data);
+    void webData(const std::vector<EspLinkArg>& args);
+    static bool topicMatch(const std::string& filter, const std::string& topic);
+    static uint16_t crc16(const uint8_t* data, size_t len);
+};
+
+#endif // _ESP_LINK_SIM_H_
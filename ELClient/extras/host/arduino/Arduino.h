@@ -0,0 +1,147 @@
+/*! \file Arduino.h
+    \brief Minimal Arduino core for building El-Client on a Linux host
+    \note Only what the library and the host programs use: the integer types, the clock, flash
+    string helpers, Print, Stream and a reduced String
+*/
+
+#ifndef _EL_HOST_ARDUINO_H_
+#define _EL_HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "avr/pgmspace.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define DEC 10
+#define HEX 16
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+// Clock, counted from program start like on the boards
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(unsigned int us);
+
+// There are no pins on the host, they read as LOW
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+// Growing string, enough of the Arduino String for the web server pages
+class String {
+  public:
+    String() {}
+    String(const char* s) : _s(s ? s : "") {}
+    String(const __FlashStringHelper* s) : _s(reinterpret_cast<const char*>(s)) {}
+    String(char c) : _s(1, c) {}
+    String(int v) : _s(std::to_string(v)) {}
+    String(unsigned int v) : _s(std::to_string(v)) {}
+    String(long v) : _s(std::to_string(v)) {}
+    String(unsigned long v) : _s(std::to_string(v)) {}
+    String(double v, int decimals = 2) { char b[32]; snprintf(b, sizeof(b), "%.*f", decimals, v); _s = b; }
+
+    String& operator+=(const String& s) { _s += s._s; return *this; }
+    String& operator+=(const char* s) { _s += s; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    String& operator+=(int v) { _s += std::to_string(v); return *this; }
+    bool concat(const String& s) { _s += s._s; return true; }
+    bool concat(const char* s) { _s += s; return true; }
+    bool concat(char c) { _s += c; return true; }
+    friend String operator+(String a, const String& b) { a += b; return a; }
+
+    bool operator==(const String& s) const { return _s == s._s; }
+    bool operator==(const char* s) const { return _s == s; }
+    bool operator!=(const String& s) const { return _s != s._s; }
+    bool equals(const String& s) const { return _s == s._s; }
+    char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+
+    unsigned int length(void) const { return _s.size(); }
+    const char* c_str(void) const { return _s.c_str(); }
+    const char* begin(void) const { return _s.c_str(); }
+    const char* end(void) const { return _s.c_str() + _s.size(); }
+    int toInt(void) const { return atoi(_s.c_str()); }
+
+  private:
+    std::string _s;
+};
+
+// Formatted output on top of write(), as in the Arduino core
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size) {
+      size_t n = 0;
+      while (size--) n += write(*buf++);
+      return n;
+    }
+    size_t write(const char* s) { return s ? write((const uint8_t*)s, strlen(s)) : 0; }
+    size_t write(const char* buf, size_t size) { return write((const uint8_t*)buf, size); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = DEC) {
+      if (base != DEC) return print((unsigned long)v, base);
+      char b[24];
+      snprintf(b, sizeof(b), "%ld", v);
+      return write(b);
+    }
+    size_t print(unsigned long v, int base = DEC) {
+      char b[24];
+      snprintf(b, sizeof(b), base == HEX ? "%lX" : "%lu", v);
+      return write(b);
+    }
+    size_t print(double v, int decimals = 2) {
+      char b[32];
+      snprintf(b, sizeof(b), "%.*f", decimals, v);
+      return write(b);
+    }
+
+    size_t println(void) { return write("\r\n"); }
+    template<typename T>
+    size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template<typename T>
+    size_t println(const T& v, int format) { size_t n = print(v, format); return n + println(); }
+};
+
+// Byte stream with the non-blocking read interface the library uses
+class Stream : public Print {
+  public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+    virtual void flush(void) {}
+
+    // Unlike the Arduino core there is no timeout, only bytes that are available are read
+    size_t readBytes(char* buf, size_t len) {
+      size_t n = 0;
+      while (n < len) {
+        int c = read();
+        if (c < 0) break;
+        buf[n++] = (char)c;
+      }
+      return n;
+    }
+    size_t readBytes(uint8_t* buf, size_t len) { return readBytes((char*)buf, len); }
+};
+
+#include "HardwareSerial.h"
+
+#endif // _EL_HOST_ARDUINO_H_
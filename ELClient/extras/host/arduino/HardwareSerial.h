@@ -0,0 +1,25 @@
+/*! \file HardwareSerial.h
+    \brief Serial port of the host build, writes to stdout and never receives
+*/
+
+#ifndef _EL_HOST_HARDWARE_SERIAL_H_
+#define _EL_HOST_HARDWARE_SERIAL_H_
+
+#include "Arduino.h"
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+    size_t write(const uint8_t* buf, size_t size) { return fwrite(buf, 1, size, stdout); }
+    using Print::write;
+    int available(void) { return 0; }
+    int read(void) { return -1; }
+    int peek(void) { return -1; }
+    void flush(void) { fflush(stdout); }
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // _EL_HOST_HARDWARE_SERIAL_H_
@@ -0,0 +1,27 @@
+/*! \file pgmspace.h
+    \brief Flash access of the host build, flash is ordinary memory there
+*/
+
+#ifndef _EL_HOST_PGMSPACE_H_
+#define _EL_HOST_PGMSPACE_H_
+
+#include <string.h>
+#include <stdint.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+
+#endif // _EL_HOST_PGMSPACE_H_
@@ -0,0 +1,273 @@
+/**
+ * Benchmark suite of the library on the host, writes its results as JSON to stdout.
+ *
+ * Measures, for payloads of 0 to 2048 bytes and 0% to 100% of bytes that need SLIP escaping
+ * (0xC0 and 0xDB):
+ * - crc:       each CRC engine over the payload
+ * - encode:    Request() of a request with the payload as its argument, into a null stream
+ * - arg:       one argument of 1 to 1024 bytes, encoded by the fused kernel of Request() and by
+ *              the byte-at-a-time escape and CRC loop it replaced (variants fused and legacy)
+ * - decode:    Process() of a response carrying the payload, from a pre-encoded frame
+ * - roundtrip: Request() and WaitReturn() through the esp-link simulator, which echoes the
+ *              payload back in a CMD_RESP_V
+ * Every case is repeated until it ran for the minimum time, the median of the runs is reported.
+ *
+ * Usage: bench_suite [min_ms [runs]]   (defaults 20 and 5)
+ * Compare two result files with benchcmp.py.
+ */
+
+#include <ELClient.h>
+#include "EspLinkSim.h"
+#include <algorithm>
+#include <chrono>
+
+#define BENCH_CMD_ECHO 0x7F   // command the simulator answers with the payload, not used by esp-link
+#define BENCH_MAX_LEN  2048
+
+static const uint16_t sizes[] = { 0, 16, 64, 256, 1024, 2048 };
+static const uint8_t densities[] = { 0, 1, 10, 50, 100 };   // percent of bytes needing escapes
+static const uint16_t argSizes[] = { 1, 4, 16, 64, 256, 1024 };
+
+// Stream that throws away everything written to it
+class NullStream : public Stream {
+  public:
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t*, size_t size) { return size; }
+    int available(void) { return 0; }
+    int read(void) { return -1; }
+    int peek(void) { return -1; }
+};
+
+// Stream that hands out the same bytes again and again, rewind() starts over
+class ReplayStream : public NullStream {
+  public:
+    std::string data;
+    size_t pos = 0;
+    void rewind(void) { pos = 0; }
+    int available(void) { return data.size() - pos; }
+    int read(void) { return pos < data.size() ? (uint8_t)data[pos++] : -1; }
+    int peek(void) { return pos < data.size() ? (uint8_t)data[pos] : -1; }
+};
+
+static uint32_t minNs = 20000000;
+static int runs = 5;
+static bool firstResult = true;
+static volatile uint32_t sink;   // keeps results alive so the work is not optimized away
+
+static uint64_t nowNs(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Median time of one call of op in nanoseconds
+template<typename Op>
+static double measure(Op op) {
+  // find the number of calls that takes at least minNs
+  uint32_t n = 1;
+  for (;;) {
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < n; i++) op();
+    uint64_t t = nowNs() - start;
+    if (t >= minNs / 4 || n >= (1u << 30)) {
+      n = t ? (uint32_t)std::max<uint64_t>(1, (uint64_t)n * minNs / t) : n * 4;
+      break;
+    }
+    n *= 4;
+  }
+  std::vector<double> times;
+  for (int r = 0; r < runs; r++) {
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < n; i++) op();
+    times.push_back((double)(nowNs() - start) / n);
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+// Payload of len bytes where density percent of the bytes are 0xC0 or 0xDB, spread evenly;
+// the other bytes are pseudo-random and never need escaping
+static std::string payload(uint16_t len, uint8_t density) {
+  std::string p(len, 0);
+  uint32_t seed = 0x2545F491, acc = 0;
+  bool end = true;
+  for (uint16_t i = 0; i < len; i++) {
+    acc += density;
+    if (acc >= 100) {
+      acc -= 100;
+      p[i] = end ? (char)0xC0 : (char)0xDB;
+      end = !end;
+      continue;
+    }
+    do {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+    } while ((uint8_t)seed == 0xC0 || (uint8_t)seed == 0xDB);
+    p[i] = (char)seed;
+  }
+  return p;
+}
+
+static void result(const char* bench, const char* variant, uint16_t size, int density,
+                   size_t wireBytes, double ns) {
+  printf("%s\n    {\"bench\": \"%s\"", firstResult ? "" : ",", bench);
+  firstResult = false;
+  if (variant) printf(", \"variant\": \"%s\"", variant);
+  printf(", \"size\": %u", size);
+  if (density >= 0) printf(", \"escape_pct\": %d", density);
+  if (wireBytes) printf(", \"wire_bytes\": %zu", wireBytes);
+  printf(", \"ns_per_op\": %.1f, \"mb_per_s\": %.2f}", ns, ns > 0 ? size * 1e3 / ns : 0.0);
+}
+
+static void benchCrc(void) {
+  typedef uint16_t (*CrcEngine)(const unsigned char*, uint16_t, uint16_t);
+  static const struct {
+    const char* name;
+    CrcEngine engine;
+  } engines[] = {
+    { "bitwise", ELClient::crc16DataBitwise },
+    { "table", ELClient::crc16DataTable },
+    { "slice4", ELClient::crc16DataSlice4 },
+  };
+  std::string p = payload(BENCH_MAX_LEN, 0);
+  for (auto& e : engines) {
+    for (uint16_t size : sizes) {
+      if (size == 0) continue;
+      const unsigned char* data = (const unsigned char*)p.data();
+      double ns = measure([&] { sink += e.engine(data, size, sink); });
+      result("crc", e.name, size, -1, 0, ns);
+    }
+  }
+}
+
+static void benchEncode(void) {
+  NullStream out;
+  ELClient esp(&out);
+  for (uint16_t size : sizes) {
+    for (uint8_t density : densities) {
+      std::string p = payload(size, density);
+      double ns = measure([&] {
+        esp.Request(BENCH_CMD_ECHO, 0, 1);
+        esp.Request(p.data(), size);
+        esp.Request();
+      });
+      std::vector<EspLinkArg> args(1, p);
+      result("encode", NULL, size, density, EspLinkSim::encode(BENCH_CMD_ECHO, 0, args).size(), ns);
+    }
+  }
+}
+
+// The argument encoding as it was done before the fused kernel, as in examples/benchmark: one
+// escape and one CRC update per byte, each escaped byte written to the stream separately
+static uint16_t legacyArg(Stream& out, const uint8_t* d, uint16_t len, uint16_t crc) {
+  out.write((uint8_t)len);
+  out.write((uint8_t)(len >> 8));
+  crc = ELClient::crc16Data((const unsigned char*)&len, 2, crc);
+  for (uint16_t l = len; l > 0; l--) {
+    if (*d == 0300 || *d == 0333) {
+      out.write((uint8_t)0333);
+      out.write((uint8_t)(*d == 0300 ? 0334 : 0335));
+    } else {
+      out.write(*d);
+    }
+    crc = ELClient::crc16Add(*d, crc);
+    d++;
+  }
+  uint16_t pad = (4-(len&3))&3;
+  while (pad--) {
+    out.write((uint8_t)0);
+    crc = ELClient::crc16Add(0, crc);
+  }
+  return crc;
+}
+
+static void benchArg(void) {
+  NullStream out;
+  ELClient esp(&out);
+  for (uint16_t size : argSizes) {
+    for (uint8_t density : densities) {
+      std::string p = payload(size, density);
+      const uint8_t* data = (const uint8_t*)p.data();
+      size_t wire = 2 + size + ((4 - (size & 3)) & 3);   // length, payload, padding
+      for (char c : p) if ((uint8_t)c == 0300 || (uint8_t)c == 0333) wire++;
+      double ns = measure([&] { sink = legacyArg(out, data, size, sink); });
+      result("arg", "legacy", size, density, wire, ns);
+      esp.Request(BENCH_CMD_ECHO, 0, 1);
+      ns = measure([&] { esp.Request(data, size); });
+      esp.Request();
+      result("arg", "fused", size, density, wire, ns);
+    }
+  }
+}
+
+static void benchDecode(void) {
+  ReplayStream in;
+  ELClient esp(&in);
+  esp.SetReceiveBufferSize(BENCH_MAX_LEN + 32);
+  for (uint16_t size : sizes) {
+    for (uint8_t density : densities) {
+      std::vector<EspLinkArg> args(1, payload(size, density));
+      in.data = EspLinkSim::encode(CMD_RESP_V, 0, args);
+      bool ok = true;
+      double ns = measure([&] {
+        in.rewind();
+        ELClientPacket* packet;
+        while ((packet = esp.Process()) == NULL && in.available()) ;
+        if (packet == NULL) ok = false;
+      });
+      if (!ok) fprintf(stderr, "decode of %u bytes at %u%% failed\n", size, density);
+      result("decode", NULL, size, density, in.data.size(), ns);
+    }
+  }
+}
+
+static void benchRoundtrip(void) {
+  EspLinkSim sim;
+  ELClient esp(&sim);
+  esp.SetReceiveBufferSize(BENCH_MAX_LEN + 32);
+  sim.setCommandHandler([&](uint16_t cmd, uint32_t value, const std::vector<EspLinkArg>& args) {
+    if (cmd != BENCH_CMD_ECHO) return false;
+    sim.reply(CMD_RESP_V, value, args);
+    return true;
+  });
+  if (!esp.Sync()) {
+    fprintf(stderr, "sync with the simulator failed\n");
+    return;
+  }
+  for (uint16_t size : sizes) {
+    for (uint8_t density : densities) {
+      std::string p = payload(size, density);
+      bool ok = true;
+      double ns = measure([&] {
+        esp.Request(BENCH_CMD_ECHO, 0, 1);
+        esp.Request(p.data(), size);
+        esp.Request();
+        if (esp.WaitReturn() == NULL) ok = false;
+      });
+      if (!ok) fprintf(stderr, "round trip of %u bytes at %u%% failed\n", size, density);
+      std::vector<EspLinkArg> args(1, p);
+      result("roundtrip", NULL, size, density,
+             EspLinkSim::encode(BENCH_CMD_ECHO, 0, args).size() +
+             EspLinkSim::encode(CMD_RESP_V, 0, args).size(), ns);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) minNs = strtoul(argv[1], NULL, 0) * 1000000UL;
+  if (argc > 2) runs = std::max(1, atoi(argv[2]));
+
+  printf("{\n  \"suite\": \"el-client\",\n  \"format\": 1,\n");
+  printf("  \"config\": {\"crc_engine\": %d, \"tx_buffer\": %d, \"rx_block\": %d, \"rx_slots\": %d, "
+         "\"trace\": %d, \"stats\": %d, \"min_ms\": %u, \"runs\": %d, \"compiler\": \"%s\"},\n",
+         ELCLIENT_CRC_ENGINE, ELCLIENT_TX_BUFFER_SIZE, ELCLIENT_RX_BLOCK_SIZE, ELCLIENT_RX_SLOTS,
+         ELCLIENT_TRACE_SIZE, ELCLIENT_STATS, minNs / 1000000, runs, __VERSION__);
+  printf("  \"results\": [");
+  benchCrc();
+  benchEncode();
+  benchArg();
+  benchDecode();
+  benchRoundtrip();
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""Compare two result files of the host benchmark suite (make bench).
+
+    python3 benchcmp.py baseline.json bench.json [threshold_pct]
+
+Prints the time per operation of every case found in both files and the change in percent.
+Changes beyond the threshold (default 5%) are marked, the exit code is 1 if any case got slower
+by more than the threshold, so the script can gate a build.
+"""
+
+import json
+import sys
+
+
+def key(r):
+    return (r["bench"], r.get("variant", ""), r["size"], r.get("escape_pct", -1))
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return data.get("config", {}), {key(r): r for r in data["results"]}
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.stderr.write(__doc__)
+        return 2
+    threshold = float(sys.argv[3]) if len(sys.argv) == 4 else 5.0
+    old_config, old = load(sys.argv[1])
+    new_config, new = load(sys.argv[2])
+    for name in sorted(set(old_config) | set(new_config)):
+        if old_config.get(name) != new_config.get(name):
+            print("config %s: %s -> %s" % (name, old_config.get(name), new_config.get(name)))
+
+    slower = 0
+    print("%-10s %-8s %5s %4s %12s %12s %8s" % ("bench", "variant", "size", "esc%", "old ns", "new ns", "change"))
+    for k in sorted(set(old) & set(new)):
+        before, after = old[k]["ns_per_op"], new[k]["ns_per_op"]
+        change = (after - before) * 100.0 / before if before else 0.0
+        mark = ""
+        if change > threshold:
+            mark = "  slower"
+            slower += 1
+        elif change < -threshold:
+            mark = "  faster"
+        bench, variant, size, esc = k
+        print("%-10s %-8s %5d %4s %12.1f %12.1f %+7.1f%%%s" % (
+            bench, variant, size, "" if esc < 0 else esc, before, after, change, mark))
+    for k in sorted(set(old) ^ set(new)):
+        print("only in %s: %s" % (sys.argv[1] if k in old else sys.argv[2], k))
+    return 1 if slower else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,184 @@
+/**
+ * Runs the library built with ELCLIENT_NO_HEAP, with ELClientStatic and ELClientWebServerStatic,
+ * against the esp-link simulator and fails if it allocates any memory once it is set up.
+ * malloc, calloc, realloc and operator new are replaced by versions that count the allocations
+ * made while the check is armed; the simulator itself uses the heap freely, so the check is
+ * paused while the library calls into it.
+ *
+ * Usage: heap_test [rounds]
+ *   rounds      number of requests per service (default 100)
+ */
+
+#include <ELClient.h>
+#include <ELClientCmd.h>
+#include <ELClientMqtt.h>
+#include <ELClientRest.h>
+#include <ELClientSocket.h>
+#include <ELClientWebServer.h>
+#include <new>
+#include "EspLinkSim.h"
+
+#ifndef ELCLIENT_NO_HEAP
+#error heap_test checks the library built with ELCLIENT_NO_HEAP
+#endif
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static bool armed;       // allocations are counted
+static bool inSim;       // the simulator is running, its allocations do not count
+static uint32_t allocs;  // allocations counted
+static size_t firstSize; // size of the first one, for the report
+
+static void counted(size_t size) {
+  if (armed && !inSim && allocs++ == 0) firstSize = size;
+}
+
+extern "C" void* malloc(size_t size) {
+  counted(size);
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+  counted(n * size);
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  counted(size);
+  return __libc_realloc(ptr, size);
+}
+
+void* operator new(size_t size) {
+  void* p = malloc(size);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+
+// Pauses the check while the simulator runs
+struct InSim {
+  bool was;
+  InSim() : was(inSim) { inSim = true; }
+  ~InSim() { inSim = was; }
+};
+
+// The simulator as the library sees it, every call into it pauses the check
+class SimLink : public Stream {
+  public:
+    EspLinkSim sim;
+    int available(void) { InSim s; return sim.available(); }
+    int read(void) { InSim s; return sim.read(); }
+    int peek(void) { InSim s; return sim.peek(); }
+    size_t write(uint8_t c) { InSim s; return sim.write(c); }
+    size_t write(const uint8_t* buf, size_t size) { InSim s; return sim.write(buf, size); }
+    using Print::write;
+};
+
+SimLink link;
+ELClientStatic<128> esp(&link);
+ELClientCmd cmd(&esp);
+ELClientMqtt mqtt(&esp);
+ELClientRest rest(&esp);
+ELClientSocket udp(&esp);
+ELClientWebServerStatic<2> webServer(&esp);
+ELClientMqttValue mqttValues[2];
+
+static bool mqttConnected;
+static uint32_t mqttReceived;
+static uint32_t udpReceived;
+static int32_t webCounter;
+
+// Call Process() until done() or the timeout, returns done()
+template<typename Done>
+static bool pump(Done done, uint32_t timeout = ESP_TIMEOUT) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start >= timeout) return false;
+    esp.Process();
+  }
+  return true;
+}
+
+static void mqttConnectedCb(void*) {
+  mqttConnected = true;
+}
+
+static void mqttDataCb(void*) {
+  mqttReceived++;
+}
+
+static void udpCb(uint8_t resp_type, uint8_t, uint16_t, char*) {
+  if (resp_type == USERCB_RECV) udpReceived++;
+}
+
+static void webCb(WebServerCommand command, char*, int) {
+  if (command == LOAD || command == REFRESH) webServer.setArgInt(F("counter"), webCounter++);
+}
+
+int main(int argc, char** argv) {
+  uint32_t rounds = argc > 1 ? strtoul(argv[1], NULL, 0) : 100;
+  link.sim.setBaud(0);
+
+  // setup may use the heap of the simulator but not of the library
+  if (!esp.Sync()) {
+    printf("sync failed\n");
+    return 1;
+  }
+  mqtt.connectedCb.attach(mqttConnectedCb);
+  mqtt.dataCb.attach(mqttDataCb);
+  mqtt.setup();
+  int err = rest.begin("sim.local");
+  int sock = udp.begin("sim.local", 7000, SOCKET_UDP, udpCb);
+  webServer.registerHandler(F("/heap.html.json"), webCb);
+  webServer.setup();
+  if (!pump([] { return mqttConnected; }) || err != 0 || sock < 0) {
+    printf("setup failed: mqtt %d, rest %d, udp %d\n", mqttConnected, err, sock);
+    return 1;
+  }
+  mqtt.subscribe("/heap/+");
+  mqtt.setQueue(mqttValues, 2, 0);
+  esp.Process();
+
+  armed = true;
+  uint32_t failed = 0;
+  char payload[32];
+  for (uint32_t i = 0; i < rounds; i++) {
+    snprintf(payload, sizeof(payload), "%u", i);
+
+    ELClientFuture<uint32_t> now = cmd.GetTime();
+    now.wait();
+    if (!now.ok()) failed++;
+
+    uint32_t expect = mqttReceived + 1;
+    mqtt.publish("/heap/value", payload);
+    if (!pump([=] { return mqttReceived == expect; })) failed++;
+    mqtt.queue("/heap/queued", payload);
+    if (!pump([=] { return mqttReceived == expect + 1; })) failed++;
+
+    char response[32];
+    rest.get("/status");
+    if (rest.waitResponse(response, sizeof(response)) != 200) failed++;
+
+    expect = udpReceived + 1;
+    udp.send(payload);
+    if (!pump([=] { return udpReceived == expect; })) failed++;
+
+    expect = link.sim.webResponses() + 1;
+    {
+      InSim s;
+      link.sim.webRequest(i == 0 ? 0 : 1, "/heap.html.json");
+    }
+    if (!pump([=] { return link.sim.webResponses() == expect; })) failed++;
+  }
+  armed = false;
+
+  printf("heap: %u rounds of time, mqtt, rest, udp and web requests, %u failed\n", rounds, failed);
+  if (allocs) printf("%u allocations after setup, the first of %u bytes\n", allocs, (uint32_t)firstSize);
+  else printf("no allocations after setup\n");
+  return allocs || failed ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * Checks how the pending-request table copes with responses that esp-link loses or sends late:
+ * a lost response must only fail its own request, a late one must not complete another request
+ * with the wrong value, and neither may make the requests after it fail in turn.
+ *
+ * Usage: pending_test
+ */
+
+#include <ELClient.h>
+#include <ELClientCmd.h>
+#include <deque>
+#include "EspLinkSim.h"
+
+EspLinkSim sim;
+ELClient esp(&sim);
+ELClientCmd cmd(&esp);
+
+static uint32_t dropTimes;         // CMD_GET_TIME requests to leave unanswered
+static bool holdTimes;             // keep the answers in held instead of sending them
+static std::deque<uint32_t> held;  // values of held answers, in request order
+static uint32_t nextTime = 1000;   // value of the next CMD_GET_TIME answer
+static uint32_t failures;
+
+// Answers CMD_GET_TIME with 1000, 1001, ... so each response can be told apart
+static bool timeHandler(uint16_t command, uint32_t, const std::vector<EspLinkArg>&) {
+  if (command != CMD_GET_TIME) return false;
+  uint32_t value = nextTime++;
+  if (dropTimes) dropTimes--;
+  else if (holdTimes) held.push_back(value);
+  else sim.reply(CMD_RESP_V, value, std::vector<EspLinkArg>());
+  return true;
+}
+
+static void release(void) {
+  sim.reply(CMD_RESP_V, held.front(), std::vector<EspLinkArg>());
+  held.pop_front();
+}
+
+static void check(bool ok, const char* what) {
+  printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+// Send a CMD_GET_TIME and register it with a short timeout
+static uint8_t request(uint32_t timeout) {
+  esp.send(CMD_GET_TIME, 0);
+  return esp.Expect(timeout);
+}
+
+// Run Process until the request is done or timed out, returns its state and value
+static uint8_t settle(uint8_t token, uint32_t* value) {
+  uint8_t state;
+  while ((state = esp.Poll(token, value)) == ELC_PENDING_WAIT) esp.Process();
+  return state;
+}
+
+int main(void) {
+  sim.setBaud(0);
+  if (!esp.Sync()) {
+    printf("sync failed\n");
+    return 1;
+  }
+  sim.setCommandHandler(timeHandler);
+  uint32_t value;
+
+  // one lost response: the request times out, the ones after it get their own responses
+  dropTimes = 1;
+  ELClientFuture<uint32_t> lost = cmd.GetTime();
+  lost.wait();
+  check(lost.state() == ELC_PENDING_TIMEOUT, "request whose response is lost times out");
+  bool allOk = true;
+  for (int i = 0; i < 8; i++) {
+    uint32_t expect = nextTime;
+    ELClientFuture<uint32_t> t = cmd.GetTime();
+    t.wait();
+    if (!t.ok() || t.value() != expect) allOk = false;
+  }
+  check(allOk, "next 8 requests get their own responses");
+
+  // a late response while another request waits is dropped
+  holdTimes = true;
+  uint8_t a = request(20);
+  uint8_t b = request(1000);
+  check(settle(a, &value) == ELC_PENDING_TIMEOUT, "first of two requests times out");
+  uint32_t expect = held.back();
+  release();
+  release();
+  check(settle(b, &value) == ELC_PENDING_DONE && value == expect,
+        "late response is dropped, second request gets its own");
+
+  // a lost response while another request waits costs that request, but no more
+  a = request(20);
+  b = request(50);
+  settle(a, &value);
+  held.pop_front(); // lost
+  release();        // taken for the late response of a
+  check(settle(b, &value) == ELC_PENDING_TIMEOUT, "request behind a lost response times out");
+  holdTimes = false;
+  uint8_t c = request(1000);
+  expect = nextTime - 1;
+  check(settle(c, &value) == ELC_PENDING_DONE && value == expect, "the request after it succeeds");
+
+  const ELClientStats& s = esp.GetStats();
+  printf("pending: %u timeouts, %u crc errors\n", s.timeouts, s.crcErrors);
+  return failures ? 1 : 0;
+}
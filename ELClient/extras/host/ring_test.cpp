@@ -0,0 +1,69 @@
+/**
+ * Feeds an ELClientRingBuffer from a second thread, the way an RX interrupt does, while the main
+ * thread decodes the frames with ELClient::Process(), and fails unless every frame arrives once,
+ * in order and intact. `make tsan` builds it with the thread sanitizer.
+ *
+ * Usage: ring_test [frames]
+ *   frames      number of frames the producer sends (default 20000)
+ */
+
+#include <ELClient.h>
+#include <thread>
+#include "EspLinkSim.h"
+
+EspLinkSim sim; // only takes the output, the input comes from the ring
+ELClient esp(&sim);
+ELClientRingBuffer<128> ring;
+
+static uint32_t retries; // pushes repeated because the ring was full
+
+// Argument of frame seq, its bytes run through all values so SLIP_END and SLIP_ESC are in there
+static std::string payload(uint32_t seq) {
+  std::string data(seq % 48, 0);
+  for (size_t i = 0; i < data.size(); i++) data[i] = (char)(seq * 7 + i);
+  return data;
+}
+
+// The RX interrupt: pushes the SLIP encoded frames byte by byte. An interrupt would drop a byte
+// that does not fit, the test waits for room instead so it can expect every frame.
+static void producer(uint32_t frames) {
+  for (uint32_t seq = 0; seq < frames; seq++) {
+    std::string slip = EspLinkSim::encode(CMD_RESP_V, seq, std::vector<EspLinkArg>(1, payload(seq)));
+    for (size_t i = 0; i < slip.size(); i++) {
+      while (!ring.push((uint8_t)slip[i])) {
+        retries++;
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000;
+  esp.SetReceiveRing(&ring);
+
+  std::thread irq(producer, frames);
+  uint32_t next = 0, lost = 0, reordered = 0, corrupt = 0;
+  uint32_t start = millis();
+  while (next < frames && millis() - start < 30000) {
+    ELClientPacket* packet = esp.Process();
+    if (packet == NULL) continue;
+    ELClientResponse resp(packet);
+    if (resp.value() < next) reordered++;
+    else lost += resp.value() - next;
+    std::string expected = payload(resp.value());
+    void* data;
+    if (resp.argc() != 1 || resp.popArgPtr(&data) != (int16_t)expected.size() ||
+        memcmp(data, expected.data(), expected.size()) != 0) corrupt++;
+    next = resp.value() + 1;
+  }
+  irq.join();
+  lost += frames - next;
+
+  const ELClientStats& stats = esp.GetStats();
+  printf("ring: %u frames, %u bytes through a 128 byte ring, %u pushes retried\n", frames,
+         stats.bytesIn, retries);
+  printf("%u lost, %u out of order, %u corrupt, %u crc errors\n", lost, reordered, corrupt,
+         stats.crcErrors);
+  return lost || reordered || corrupt || stats.crcErrors ? 1 : 0;
+}
@@ -0,0 +1,315 @@
+/**
+ * Runs the library against the esp-link simulator on the host, no hardware needed.
+ * Syncs, then does a series of MQTT loopback publishes (by topic, by topic alias and through the
+ * latest-value queue, in batches and through a broker outage), REST requests, UDP echoes and web server requests and prints how long each
+ * round trip took.
+ *
+ * Usage: sim_demo [baud [latency_us [rounds]]]
+ *   baud        serial line speed that is simulated, 0 for no pacing (default 115200)
+ *   latency_us  time esp-link takes before it answers a request (default 0)
+ *   rounds      number of round trips per service (default 100)
+ */
+
+#include <ELClient.h>
+#include <ELClientCmd.h>
+#include <ELClientMqtt.h>
+#include <ELClientRest.h>
+#include <ELClientSocket.h>
+#include <ELClientWebServer.h>
+#include "EspLinkSim.h"
+
+EspLinkSim sim;
+ELClient esp(&sim);
+ELClientCmd cmd(&esp);
+ELClientMqtt mqtt(&esp);
+ELClientRest rest(&esp);
+ELClientSocket udp(&esp);
+ELClientWebServer webServer(&esp);
+ELClientMqttValue mqttValues[2];
+ELClientMqttRoute mqttRoutes[4];
+ELClientMqttBatch mqttBatch;
+uint8_t mqttBatchBuf[64];
+uint8_t mqttStoreBuf[32 * ELCLIENT_MQTT_STORE_SLOT];
+ELClientRamStorage mqttStorage(mqttStoreBuf, sizeof(mqttStoreBuf));
+ELClientMqttStore mqttStore(&mqttStorage);
+
+static bool mqttConnected;
+static uint32_t mqttReceived;
+static int32_t offlineNext;    // next value expected on /sim/offline/value
+static bool offlineOrdered = true;
+static uint32_t udpReceived;
+static int32_t webCounter;
+static char webName[32];
+
+// Round-trip times of one service
+struct Timing {
+  const char* name;
+  uint32_t count, failed;
+  uint64_t total;
+  uint32_t min, max;
+  uint32_t start, elapsed;
+};
+
+static void timingBegin(Timing& t, const char* name) {
+  memset(&t, 0, sizeof(t));
+  t.name = name;
+  t.min = 0xFFFFFFFF;
+  t.start = micros();
+}
+
+static void timingAdd(Timing& t, uint32_t us, bool ok) {
+  if (!ok) {
+    t.failed++;
+    return;
+  }
+  t.count++;
+  t.total += us;
+  if (us < t.min) t.min = us;
+  if (us > t.max) t.max = us;
+}
+
+static void timingPrint(Timing& t) {
+  t.elapsed = micros() - t.start;
+  if (t.count == 0) t.min = 0;
+  printf("%-7s %5u ok %3u failed  rtt avg %7.1f us  min %6u  max %6u  %8.1f/s\n", t.name,
+         t.count, t.failed, t.count ? (double)t.total / t.count : 0.0, t.min, t.max,
+         t.elapsed ? t.count * 1e6 / t.elapsed : 0.0);
+}
+
+// Call Process() until done() or the timeout, returns done()
+template<typename Done>
+static bool pump(Done done, uint32_t timeout = ESP_TIMEOUT) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start >= timeout) return false;
+    esp.Process();
+  }
+  return true;
+}
+
+static void wifiCb(void* response) {
+  ELClientResponse* res = (ELClientResponse*)response;
+  uint8_t status;
+  res->popArg(&status, 1);
+  printf("wifi status %u\n", status);
+}
+
+static void mqttConnectedCb(void*) {
+  mqttConnected = true;
+}
+
+// routed from the receive buffer, see mqtt.on() below
+static void mqttValue(const char*, uint16_t, const uint8_t*, uint16_t) {
+  mqttReceived++;
+}
+
+static void mqttOffline(const char*, uint16_t, const uint8_t* data, uint16_t len) {
+  char buf[12];
+  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+  memcpy(buf, data, len);
+  buf[len] = 0;
+  if (atoi(buf) != offlineNext) offlineOrdered = false;
+  offlineNext = atoi(buf) + 1;
+}
+
+// messages no route takes
+static void mqttDataCb(void* response) {
+  ELClientResponse* res = (ELClientResponse*)response;
+  printf("unrouted message on %s\n", res->popString().c_str());
+}
+
+static void udpCb(uint8_t resp_type, uint8_t, uint16_t, char*) {
+  if (resp_type == USERCB_RECV) udpReceived++;
+}
+
+static void webCb(WebServerCommand command, char* data, int) {
+  switch (command) {
+    case LOAD:
+    case REFRESH:
+      webServer.setArgInt(F("counter"), webCounter++);
+      webServer.setArgString(F("name"), webName);
+      break;
+    case SET_FIELD:
+      if (strcmp(data, "name") == 0) {
+        strncpy(webName, webServer.getArgString(), sizeof(webName) - 1);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t baud = argc > 1 ? strtoul(argv[1], NULL, 0) : 115200;
+  uint32_t latency = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+  uint32_t rounds = argc > 3 ? strtoul(argv[3], NULL, 0) : 100;
+  sim.setBaud(baud);
+  sim.setLatency(latency);
+  printf("simulated link: %u baud, %u us esp-link latency, %u rounds\n", baud, latency, rounds);
+
+  esp.wifiCb.attach(wifiCb);
+  if (!esp.Sync()) {
+    printf("sync failed\n");
+    return 1;
+  }
+  printf("synced, esp-link time %u\n", (uint32_t)cmd.GetTime());
+
+  mqtt.connectedCb.attach(mqttConnectedCb);
+  mqtt.dataCb.attach(mqttDataCb);
+  mqtt.setup();
+  if (!pump([] { return mqttConnected; })) {
+    printf("mqtt did not connect\n");
+    return 1;
+  }
+  mqtt.setRoutes(mqttRoutes, 4);
+  mqtt.on("/sim/+/value", mqttValue);
+  mqtt.on("/sim/offline/value", mqttOffline);
+  mqtt.subscribe("/sim/+/value");
+
+  int err = rest.begin("sim.local");
+  int sock = udp.begin("sim.local", 7000, SOCKET_UDP, udpCb);
+  webServer.registerHandler(F("/demo.html.json"), webCb);
+  webServer.setup();
+  esp.Process();
+  if (err != 0 || sock < 0) {
+    printf("setup failed: rest %d, udp %d\n", err, sock);
+    return 1;
+  }
+
+  Timing t;
+  char payload[64];
+
+  timingBegin(t, "mqtt");
+  for (uint32_t i = 0; i < rounds; i++) {
+    snprintf(payload, sizeof(payload), "%u", i);
+    uint32_t expect = mqttReceived + 1;
+    uint32_t start = micros();
+    mqtt.publish("/sim/counter/value", payload);
+    bool ok = pump([=] { return mqttReceived == expect; });
+    timingAdd(t, micros() - start, ok);
+  }
+  timingPrint(t);
+
+  int8_t alias = mqtt.registerTopic("/sim/alias/value");
+  timingBegin(t, "mqtt-id");
+  for (uint32_t i = 0; i < rounds; i++) {
+    snprintf(payload, sizeof(payload), "%u", i);
+    uint32_t expect = mqttReceived + 1;
+    uint32_t start = micros();
+    mqtt.publishId(alias, payload);
+    bool ok = pump([=] { return mqttReceived == expect; });
+    timingAdd(t, micros() - start, ok);
+  }
+  timingPrint(t);
+
+  // bytes on the line per publish, by topic and by topic alias
+  uint32_t bytes = sim.stats().bytesIn;
+  uint32_t expect = mqttReceived + 2;
+  mqtt.publish("/sim/counter/value", "1234");
+  uint32_t topicBytes = sim.stats().bytesIn - bytes;
+  mqtt.publishId(alias, "1234");
+  uint32_t aliasBytes = sim.stats().bytesIn - bytes - topicBytes;
+  pump([=] { return mqttReceived == expect; });
+  printf("publish of 4 bytes: %u bytes by topic, %u bytes by alias", topicBytes, aliasBytes);
+  if (baud) printf(", at most %u/s and %u/s", baud / 10 / topicBytes, baud / 10 / aliasBytes);
+  printf("\n");
+
+  // a burst of readings through the latest-value queue, only the newest ones go out
+  mqtt.setQueue(mqttValues, 2, 0);
+  uint32_t received = mqttReceived;
+  for (uint32_t i = 0; i < rounds; i++) {
+    snprintf(payload, sizeof(payload), "%u", i);
+    mqtt.queue(i & 1 ? "/sim/odd/value" : "/sim/even/value", payload);
+  }
+  pump([=] { return mqttReceived == received + 2; });
+  pump([] { return false; }, 10);
+  printf("queue: %u values of 2 topics, %u publishes delivered\n", rounds, mqttReceived - received);
+
+  // the same readings in batches, sent when the buffer is full or after 20ms
+  mqtt.setBatch(&mqttBatch, "/sim/batch/value", mqttBatchBuf, sizeof(mqttBatchBuf), 20);
+  received = mqttReceived;
+  bytes = sim.stats().bytesIn;
+  for (uint32_t i = 0; i < rounds; i++) {
+    snprintf(payload, sizeof(payload), "%u", i);
+    mqtt.batch(&mqttBatch, payload);
+    esp.Process();
+  }
+  pump([] { return mqttBatch.count == 0; });
+  for (uint32_t seen = ~0u; seen != mqttReceived; ) {
+    seen = mqttReceived;
+    pump([] { return false; }, 500);
+  }
+  printf("batch: %u messages in %u publishes, %u bytes on the line (%u by topic one by one)\n",
+         rounds, mqttReceived - received, sim.stats().bytesIn - bytes, rounds * topicBytes);
+
+  // broker outage: publishes go to the store and are replayed in order, 1 per ms, afterwards
+  mqtt.setStore(&mqttStore, 1);
+  sim.setMqttConnected(false);
+  pump([] { return !mqtt.connected(); });
+  uint32_t lost = sim.stats().mqttLost;
+  received = mqttReceived;
+  for (uint32_t i = 0; i < 20; i++) {
+    snprintf(payload, sizeof(payload), "%u", i);
+    mqtt.publish("/sim/offline/value", payload);
+    esp.Process();
+  }
+  uint16_t stored = mqttStore.count();
+  uint32_t start = millis();
+  sim.setMqttConnected(true);
+  bool replayed = pump([=] { return mqttReceived == received + 20; });
+  bool offlineOk = replayed && offlineOrdered && sim.stats().mqttLost == lost;
+  printf("offline: %u publishes stored during a broker outage, %u replayed %s in %u ms, %u lost\n",
+         stored, mqttReceived - received, offlineOrdered ? "in order" : "out of order",
+         millis() - start, sim.stats().mqttLost - lost);
+
+  timingBegin(t, "rest");
+  for (uint32_t i = 0; i < rounds; i++) {
+    char response[64];
+    uint32_t start = micros();
+    rest.get("/status");
+    uint16_t code = rest.waitResponse(response, sizeof(response));
+    timingAdd(t, micros() - start, code == 200);
+  }
+  timingPrint(t);
+
+  timingBegin(t, "udp");
+  for (uint32_t i = 0; i < rounds; i++) {
+    snprintf(payload, sizeof(payload), "ping %u", i);
+    uint32_t expect = udpReceived + 1;
+    uint32_t start = micros();
+    udp.send(payload);
+    bool ok = pump([=] { return udpReceived == expect; });
+    timingAdd(t, micros() - start, ok);
+  }
+  timingPrint(t);
+
+  timingBegin(t, "web");
+  for (uint32_t i = 0; i < rounds; i++) {
+    uint32_t expect = sim.webResponses() + 1;
+    uint32_t start = micros();
+    if (i == rounds / 2) {
+      std::vector<std::pair<std::string, std::string> > form;
+      form.push_back(std::make_pair(std::string("name"), std::string("simulator")));
+      sim.webRequest(3, "/demo.html.json", form);
+    }
+    sim.webRequest(i == 0 ? 0 : 1, "/demo.html.json");
+    bool ok = pump([=] { return sim.webResponses() == expect; });
+    timingAdd(t, micros() - start, ok);
+  }
+  timingPrint(t);
+
+  const std::map<std::string, std::string>& fields = sim.webFields();
+  if (!fields.empty()) {
+    printf("web fields:");
+    for (auto& f : fields) printf(" %s=%s", f.first.c_str(), f.second.c_str());
+    printf("\n");
+  }
+
+  const ELClientStats& s = esp.GetStats();
+  printf("library:   %u frames in, %u out, %u bytes in, %u out, %u crc errors, %u unhandled\n",
+         s.framesIn, s.framesOut, s.bytesIn, s.bytesOut, s.crcErrors, s.unhandled);
+  const EspLinkSimStats& ss = sim.stats();
+  printf("simulator: %u frames in, %u out, %u bytes in, %u out, %u crc errors, %u malformed, %u unknown\n",
+         ss.framesIn, ss.framesOut, ss.bytesIn, ss.bytesOut, ss.crcErrors, ss.malformed, ss.unknown);
+  return ss.crcErrors || ss.malformed || s.crcErrors || !offlineOk ? 1 : 0;
+}